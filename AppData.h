@@ -0,0 +1,10 @@
+#pragma once
+#include <JuceHeader.h>
+
+// The one folder the app keeps its own data in: the library index, the
+// waveform and seek caches, and saved profiler reports.
+inline juce::File getAppDataDirectory()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+        .getChildFile("Unified Audio Player");
+}
@@ -0,0 +1,226 @@
+#include "AudioProfiler.h"
+
+namespace
+{
+    // time spent in nested stages, so that each stage reports only its own
+    thread_local juce::int64 childTicks = 0;
+}
+
+AudioProfiler& AudioProfiler::getInstance()
+{
+    static AudioProfiler instance;
+    return instance;
+}
+
+AudioProfiler::AudioProfiler()
+    : rings(new Ring[numStages]),
+      ticksToMicroseconds(1.0e6 / (double)juce::Time::getHighResolutionTicksPerSecond())
+{
+}
+
+void AudioProfiler::setEnabled(bool shouldBeEnabled)
+{
+    lastCallbackTicks.store(0);
+    enabled.store(shouldBeEnabled);
+}
+
+//==============================================================================
+AudioProfiler::ScopedStage::ScopedStage(Stage stageToTime) noexcept
+    : stage(stageToTime),
+      active(AudioProfiler::getInstance().isEnabled())
+{
+    if (active)
+    {
+        outerChildTicks = childTicks;
+        childTicks = 0;
+        startTicks = juce::Time::getHighResolutionTicks();
+    }
+}
+
+AudioProfiler::ScopedStage::~ScopedStage() noexcept
+{
+    if (!active)
+        return;
+
+    const auto total = juce::Time::getHighResolutionTicks() - startTicks;
+    AudioProfiler::getInstance().record(stage, total - childTicks);
+    childTicks = outerChildTicks + total;
+}
+
+AudioProfiler::ScopedCallback::ScopedCallback(int numSamples, double sampleRate) noexcept
+    : active(AudioProfiler::getInstance().isEnabled())
+{
+    if (!active || sampleRate <= 0.0)
+        return;
+
+    auto& profiler = AudioProfiler::getInstance();
+    startTicks = juce::Time::getHighResolutionTicks();
+    budgetSeconds = numSamples / sampleRate;
+
+    const auto previous = profiler.lastCallbackTicks.exchange(startTicks);
+    if (previous != 0)
+    {
+        const double interval = juce::Time::highResolutionTicksToSeconds(startTicks - previous);
+        if (interval > budgetSeconds * 1.5)
+            profiler.lateCallbacks.fetch_add(1);
+    }
+}
+
+AudioProfiler::ScopedCallback::~ScopedCallback() noexcept
+{
+    if (!active || budgetSeconds <= 0.0)
+        return;
+
+    auto& profiler = AudioProfiler::getInstance();
+    const double elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    const float load = (float)(elapsed / budgetSeconds);
+
+    if (load > 1.0f)
+        profiler.deadlineMisses.fetch_add(1);
+
+    auto worst = profiler.worstLoad.load();
+    while (load > worst && !profiler.worstLoad.compare_exchange_weak(worst, load)) {}
+}
+
+//==============================================================================
+void AudioProfiler::record(Stage stage, juce::int64 ticks) noexcept
+{
+    auto& ring = rings[(int)stage];
+    const auto index = ring.writeIndex.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = ring.slots[index % ringSize];
+    slot.microseconds.store((float)(ticks * ticksToMicroseconds), std::memory_order_relaxed);
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+int AudioProfiler::binForMicroseconds(float microseconds) noexcept
+{
+    if (microseconds <= 1.0f)
+        return 0;
+
+    return juce::jmin(numBins - 1, (int)(std::log2(microseconds) * binsPerOctave));
+}
+
+float AudioProfiler::microsecondsForBin(int bin) noexcept
+{
+    return std::exp2((float)bin / binsPerOctave);
+}
+
+void AudioProfiler::update()
+{
+    for (int stage = 0; stage < numStages; ++stage)
+    {
+        auto& ring = rings[stage];
+        auto& histogram = histograms[stage];
+        const auto written = ring.writeIndex.load(std::memory_order_relaxed);
+
+        // if we fell a whole ring behind, the oldest samples are gone
+        if (written - ring.readIndex > (juce::uint32)ringSize)
+            ring.readIndex = written - (juce::uint32)ringSize;
+
+        for (; ring.readIndex != written; ++ring.readIndex)
+        {
+            // claimed but not written yet: pick it up next time round
+            const auto& slot = ring.slots[ring.readIndex % ringSize];
+            if (slot.sequence.load(std::memory_order_acquire) != ring.readIndex + 1)
+                break;
+
+            const float microseconds = slot.microseconds.load(std::memory_order_relaxed);
+            ++histogram.bins[binForMicroseconds(microseconds)];
+            ++histogram.count;
+            histogram.max = juce::jmax(histogram.max, microseconds);
+        }
+    }
+}
+
+AudioProfiler::StageStats AudioProfiler::getStats(Stage stage) const
+{
+    const auto& histogram = histograms[(int)stage];
+
+    StageStats stats;
+    stats.count = histogram.count;
+    stats.max = histogram.max;
+
+    if (histogram.count == 0)
+        return stats;
+
+    // each percentile is reported as the upper edge of the bin it falls in
+    auto percentile = [&histogram](double fraction)
+    {
+        const auto target = (juce::uint64)std::ceil(fraction * (double)histogram.count);
+        juce::uint64 seen = 0;
+
+        for (int bin = 0; bin < numBins; ++bin)
+        {
+            seen += histogram.bins[bin];
+            if (seen >= target)
+                return juce::jmin(histogram.max, microsecondsForBin(bin + 1));
+        }
+
+        return histogram.max;
+    };
+
+    stats.p50 = percentile(0.5);
+    stats.p90 = percentile(0.9);
+    stats.p99 = percentile(0.99);
+    stats.p999 = percentile(0.999);
+    return stats;
+}
+
+void AudioProfiler::reset()
+{
+    update();
+
+    for (auto& histogram : histograms)
+        histogram = Histogram();
+
+    deadlineMisses.store(0);
+    lateCallbacks.store(0);
+    worstLoad.store(0.0f);
+}
+
+juce::String AudioProfiler::getStageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::callback: return "callback";
+    case Stage::decode:   return "decode";
+    case Stage::resample: return "resample";
+    case Stage::stretch:  return "stretch";
+    case Stage::eq:       return "eq";
+    case Stage::gain:     return "gain";
+    case Stage::mix:      return "mix";
+    case Stage::numStages: break;
+    }
+
+    return {};
+}
+
+juce::String AudioProfiler::createReport() const
+{
+    juce::String report;
+    report << "stage        count        p50us    p90us    p99us  p99.9us    maxus\n";
+
+    for (int stage = 0; stage < numStages; ++stage)
+    {
+        const auto stats = getStats((Stage)stage);
+        report << getStageName((Stage)stage).paddedRight(' ', 9)
+               << juce::String((juce::int64)stats.count).paddedLeft(' ', 9)
+               << juce::String(stats.p50, 1).paddedLeft(' ', 13)
+               << juce::String(stats.p90, 1).paddedLeft(' ', 9)
+               << juce::String(stats.p99, 1).paddedLeft(' ', 9)
+               << juce::String(stats.p999, 1).paddedLeft(' ', 9)
+               << juce::String(stats.max, 1).paddedLeft(' ', 9) << "\n";
+    }
+
+    report << "\ndeadline misses: " << (int)getDeadlineMisses()
+           << "\nlate callbacks:  " << (int)getLateCallbacks()
+           << "\nworst load:      " << juce::String(getWorstLoad() * 100.0f, 1) << "% of the buffer period\n";
+    return report;
+}
+
+bool AudioProfiler::dumpToFile(const juce::File& file)
+{
+    update();
+    return file.replaceWithText("Audio profile, " + juce::Time::getCurrentTime().toString(true, true) + "\n\n"
+                                + createReport());
+}
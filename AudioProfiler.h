@@ -0,0 +1,138 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Hot-path timing for the audio callback and the stages under it.
+//
+// Audio-side code marks a stage with an AudioProfiler::ScopedStage. Times are
+// exclusive: a stage that calls into another one (the resampler pulling from
+// the decoder, say) doesn't count its child's time. Each measurement goes
+// into a lock-free ring per stage, which any number of threads can write to,
+// and the message thread drains the rings into histograms in update().
+//
+// When profiling is disabled a ScopedStage costs one relaxed atomic load.
+class AudioProfiler
+{
+public:
+    enum class Stage
+    {
+        callback,   // the whole device callback
+        decode,     // reading from the transports, disk buffer and RAM loops
+        resample,   // varispeed
+        stretch,    // key-lock time-stretch
+        eq,         // per-deck EQ and filter
+        gain,       // per-deck gain, fades and limiter
+        mix,        // summing decks into the output
+        numStages
+    };
+
+    static constexpr int numStages = (int)Stage::numStages;
+
+    static AudioProfiler& getInstance();
+
+    void setEnabled(bool shouldBeEnabled);
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Times the enclosing scope as the given stage.
+    class ScopedStage
+    {
+    public:
+        explicit ScopedStage(Stage stageToTime) noexcept;
+        ~ScopedStage() noexcept;
+
+    private:
+        Stage stage;
+        juce::int64 startTicks = 0;
+        juce::int64 outerChildTicks = 0;
+        bool active;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedStage)
+    };
+
+    // Times the device callback and checks it against the buffer's deadline.
+    // Also counts callbacks that arrive late, which is where the device
+    // would have dropped out.
+    class ScopedCallback
+    {
+    public:
+        ScopedCallback(int numSamples, double sampleRate) noexcept;
+        ~ScopedCallback() noexcept;
+
+    private:
+        ScopedStage stage{ Stage::callback };
+        juce::int64 startTicks = 0;
+        double budgetSeconds = 0.0;
+        bool active;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedCallback)
+    };
+
+    struct StageStats
+    {
+        juce::uint64 count = 0;
+        float p50 = 0.0f, p90 = 0.0f, p99 = 0.0f, p999 = 0.0f, max = 0.0f; // microseconds
+    };
+
+    // Message thread. Call update() regularly while profiling, often enough
+    // that the rings don't wrap (a few times a second is plenty).
+    void update();
+    StageStats getStats(Stage stage) const;
+    juce::uint32 getDeadlineMisses() const { return deadlineMisses.load(); }
+    juce::uint32 getLateCallbacks() const { return lateCallbacks.load(); }
+    float getWorstLoad() const { return worstLoad.load(); }
+    void reset();
+
+    // Writes the current statistics as a text report. Message thread.
+    bool dumpToFile(const juce::File& file);
+    juce::String createReport() const;
+
+    static juce::String getStageName(Stage stage);
+
+private:
+    AudioProfiler();
+
+    void record(Stage stage, juce::int64 ticks) noexcept;
+
+    static constexpr int ringSize = 8192;
+    static constexpr int binsPerOctave = 8;
+    static constexpr int numBins = 20 * binsPerOctave;
+
+    // Multi-producer: a writer claims a slot by bumping writeIndex, so a slow
+    // reader loses the oldest samples rather than blocking anybody. Claiming
+    // comes before writing, so each slot is stamped with its index + 1 once
+    // its sample is in, and the reader stops at the first slot that isn't.
+    struct Slot
+    {
+        std::atomic<juce::uint32> sequence{ 0 };
+        std::atomic<float> microseconds{ 0.0f };
+    };
+
+    struct Ring
+    {
+        std::atomic<juce::uint32> writeIndex{ 0 };
+        Slot slots[ringSize];
+        juce::uint32 readIndex = 0;
+    };
+
+    // log-spaced from 1us to about 1s, eight bins per octave
+    struct Histogram
+    {
+        juce::uint32 bins[numBins] = {};
+        juce::uint64 count = 0;
+        float max = 0.0f;
+    };
+
+    static int binForMicroseconds(float microseconds) noexcept;
+    static float microsecondsForBin(int bin) noexcept;
+
+    std::atomic<bool> enabled{ false };
+    std::unique_ptr<Ring[]> rings;
+    Histogram histograms[numStages];
+    const double ticksToMicroseconds;
+
+    std::atomic<juce::uint32> deadlineMisses{ 0 };
+    std::atomic<juce::uint32> lateCallbacks{ 0 };
+    std::atomic<float> worstLoad{ 0.0f };
+    std::atomic<juce::int64> lastCallbackTicks{ 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(AudioProfiler)
+};
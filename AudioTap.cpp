@@ -0,0 +1,45 @@
+#include "AudioTap.h"
+
+AudioTap::AudioTap(int capacityInSamples)
+    : fifo(capacityInSamples),
+      ring(numChannels, capacityInSamples)
+{
+    ring.clear();
+}
+
+void AudioTap::push(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    const int sourceChannels = buffer.getNumChannels();
+    if (sourceChannels == 0)
+        return;
+
+    const auto scope = fifo.write(juce::jmin(numSamples, fifo.getFreeSpace()));
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const int source = juce::jmin(channel, sourceChannels - 1);
+
+        if (scope.blockSize1 > 0)
+            ring.copyFrom(channel, scope.startIndex1, buffer, source, startSample, scope.blockSize1);
+
+        if (scope.blockSize2 > 0)
+            ring.copyFrom(channel, scope.startIndex2, buffer, source, startSample + scope.blockSize1, scope.blockSize2);
+    }
+}
+
+int AudioTap::pull(juce::AudioBuffer<float>& dest)
+{
+    const auto scope = fifo.read(juce::jmin(dest.getNumSamples(), fifo.getNumReady()));
+    const int destChannels = juce::jmin(numChannels, dest.getNumChannels());
+
+    for (int channel = 0; channel < destChannels; ++channel)
+    {
+        if (scope.blockSize1 > 0)
+            dest.copyFrom(channel, 0, ring, channel, scope.startIndex1, scope.blockSize1);
+
+        if (scope.blockSize2 > 0)
+            dest.copyFrom(channel, scope.blockSize1, ring, channel, scope.startIndex2, scope.blockSize2);
+    }
+
+    return scope.blockSize1 + scope.blockSize2;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Lets a background thread see what an audio callback is producing. The
+// audio thread copies each block into a ring buffer and carries on; if the
+// reader has fallen behind, the samples that don't fit are dropped rather
+// than waited for. One writer and one reader, as with LockFreeFifo; the
+// writer may move between threads from block to block as long as the
+// blocks themselves are ordered, as DeckMixer's are.
+class AudioTap
+{
+public:
+    static constexpr int numChannels = 2;
+
+    explicit AudioTap(int capacityInSamples = 1 << 15);
+
+    // Before the audio thread starts pushing.
+    void prepare(double sampleRate) { currentSampleRate.store(sampleRate); }
+    double getSampleRate() const { return currentSampleRate.load(); }
+
+    // Audio thread. A mono buffer is copied to both channels.
+    void push(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    // Reader thread. Moves up to dest's size of the oldest samples into dest
+    // and returns how many there were.
+    int pull(juce::AudioBuffer<float>& dest);
+
+    int getNumReady() const { return fifo.getNumReady(); }
+
+private:
+    juce::AbstractFifo fifo;
+    juce::AudioBuffer<float> ring;
+    std::atomic<double> currentSampleRate{ 0.0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioTap)
+};
@@ -0,0 +1,287 @@
+// Engine benchmark: drives PlayerAudio decks through the DeckMixer on a
+// simulated device clock, across block sizes, sample rates, formats, speeds
+// and deck counts, and reports ns/sample, the worst callback against its
+// deadline, and heap allocations made on the callback thread.
+//
+// Build this file as a console target, together with the engine sources and
+// without Main.cpp, with UNIFIED_AUDIO_BENCHMARK=1 defined. It has its own
+// main() and replaces the global operator new, so without that flag it
+// compiles to nothing and can sit in the app's project alongside everything
+// else.
+//
+//   UnifiedAudioBenchmark [options] [audio files...]
+//     --blocks 32,128,512,2048   device block sizes
+//     --rates 44100,48000        device sample rates
+//     --speeds 1,1.25            deck speed ratios
+//     --decks 1,2,4              deck counts
+//     --workers <n>              mixer worker threads (0: all decks render on
+//                                the callback thread, so every allocation counts)
+//     --seconds <s>              measured audio per scenario (2)
+//     --free-run                 don't pace callbacks; decode inline instead
+//                                of through the read-ahead thread
+//     --csv <file>               also write the results as CSV
+//
+// With no files, a WAV, a FLAC and an Ogg Vorbis file are synthesised in a
+// temporary folder. JUCE can't encode MP3, so pass one in to cover it.
+#if UNIFIED_AUDIO_BENCHMARK
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "PlayerAudio.h"
+#include "DeckMixer.h"
+
+//==============================================================================
+namespace
+{
+    std::atomic<juce::uint64> allocationCount{ 0 };
+    thread_local bool countAllocations = false;
+}
+
+void* operator new(std::size_t size)
+{
+    if (countAllocations)
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+//==============================================================================
+namespace
+{
+    struct Scenario
+    {
+        juce::File file;
+        int blockSize = 512;
+        double sampleRate = 44100.0;
+        double speed = 1.0;
+        int numDecks = 1;
+    };
+
+    struct Result
+    {
+        double nsPerSample = 0.0;         // per output sample, all decks together
+        double nsPerDeckSample = 0.0;
+        double worstCallbackUs = 0.0;
+        double worstLoad = 0.0;           // worst callback / buffer period
+        int deadlineMisses = 0;
+        double allocationsPerCallback = 0.0;
+        juce::uint64 maxAllocations = 0;
+    };
+
+    juce::Array<double> parseList(const juce::String& text, const juce::String& fallback)
+    {
+        juce::Array<double> values;
+        for (auto& token : juce::StringArray::fromTokens(text.isNotEmpty() ? text : fallback, ",", {}))
+            if (token.trim().isNotEmpty())
+                values.add(token.trim().getDoubleValue());
+        return values;
+    }
+
+    // a few seconds of stereo material with some movement in it, so decoders
+    // and the time-domain code paths get realistic data rather than silence
+    juce::Array<juce::File> synthesiseTestFiles(const juce::File& folder)
+    {
+        constexpr double rate = 44100.0;
+        constexpr int length = (int)(rate * 20);
+
+        juce::AudioBuffer<float> audio(2, length);
+        juce::Random random(1234);
+        for (int i = 0; i < length; ++i)
+        {
+            const double t = i / rate;
+            const float tone = 0.3f * (float)std::sin(juce::MathConstants<double>::twoPi * (220.0 + 110.0 * std::sin(t)) * t);
+            audio.setSample(0, i, tone + 0.05f * (random.nextFloat() - 0.5f));
+            audio.setSample(1, i, tone * 0.8f + 0.05f * (random.nextFloat() - 0.5f));
+        }
+
+        juce::Array<juce::File> files;
+        juce::OwnedArray<juce::AudioFormat> formats;
+        formats.add(new juce::WavAudioFormat());
+        formats.add(new juce::FlacAudioFormat());
+        formats.add(new juce::OggVorbisAudioFormat());
+
+        for (auto* format : formats)
+        {
+            auto file = folder.getChildFile("benchmark" + format->getFileExtensions()[0]);
+            file.deleteFile();
+
+            auto stream = std::make_unique<juce::FileOutputStream>(file);
+            const int bits = format->getPossibleBitDepths().contains(24) ? 24 : 16;
+            std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), rate, 2, bits, {},
+                                                                                    format->getQualityOptions().size() / 2));
+            if (writer == nullptr)
+                continue;
+
+            stream.release();
+            writer->writeFromAudioSampleBuffer(audio, 0, length);
+            files.add(file);
+        }
+
+        return files;
+    }
+
+    Result runScenario(juce::AudioFormatManager& formatManager, const Scenario& scenario,
+                       int numWorkers, double seconds, bool freeRun)
+    {
+        juce::OwnedArray<PlayerAudio> players;
+        DeckMixer mixer(numWorkers);
+
+        for (int i = 0; i < scenario.numDecks; ++i)
+        {
+            auto* player = players.add(new PlayerAudio(formatManager));
+
+            // free-running outpaces the read-ahead thread, so decode inline
+            // where it's measured, rather than timing a starved buffer
+            if (freeRun)
+                player->setReadAheadBufferSize(0);
+
+            player->loadFile(scenario.file);
+            player->setLooping(true);
+            player->setSpeed(scenario.speed);
+            player->play();
+            mixer.addDeck(player, 1.0f / (float)scenario.numDecks);
+        }
+
+        mixer.prepareToPlay(scenario.blockSize, scenario.sampleRate);
+
+        juce::AudioBuffer<float> output(2, scenario.blockSize);
+        const double period = scenario.blockSize / scenario.sampleRate;
+        const int warmUpCallbacks = (int)(0.5 / period);
+        const int measuredCallbacks = juce::jmax(1, (int)(seconds / period));
+
+        Result result;
+        double totalSeconds = 0.0;
+        juce::uint64 totalAllocations = 0;
+        auto nextDeadline = juce::Time::getMillisecondCounterHiRes();
+
+        for (int callback = 0; callback < warmUpCallbacks + measuredCallbacks; ++callback)
+        {
+            if (!freeRun)
+            {
+                // the simulated device clock: one callback per buffer period
+                nextDeadline += period * 1000.0;
+                while (juce::Time::getMillisecondCounterHiRes() < nextDeadline)
+                    juce::Thread::yield();
+            }
+
+            const auto allocationsBefore = allocationCount.load();
+            countAllocations = true;
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            mixer.getNextAudioBlock(juce::AudioSourceChannelInfo(&output, 0, scenario.blockSize));
+
+            const auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+            countAllocations = false;
+            const auto allocations = allocationCount.load() - allocationsBefore;
+
+            if (callback < warmUpCallbacks)
+                continue;
+
+            totalSeconds += elapsed;
+            totalAllocations += allocations;
+            result.maxAllocations = juce::jmax(result.maxAllocations, allocations);
+            result.worstCallbackUs = juce::jmax(result.worstCallbackUs, elapsed * 1.0e6);
+            if (elapsed > period)
+                ++result.deadlineMisses;
+        }
+
+        mixer.releaseResources();
+
+        const double numSamples = (double)measuredCallbacks * scenario.blockSize;
+        result.nsPerSample = totalSeconds * 1.0e9 / numSamples;
+        result.nsPerDeckSample = result.nsPerSample / scenario.numDecks;
+        result.worstLoad = result.worstCallbackUs * 1.0e-6 / period;
+        result.allocationsPerCallback = (double)totalAllocations / measuredCallbacks;
+        return result;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    const auto blockSizes = parseList(args.removeValueForOption("--blocks"), "32,128,512,2048");
+    const auto sampleRates = parseList(args.removeValueForOption("--rates"), "44100,48000");
+    const auto speeds = parseList(args.removeValueForOption("--speeds"), "1,1.25");
+    const auto deckCounts = parseList(args.removeValueForOption("--decks"), "1,2,4");
+    const auto workersText = args.removeValueForOption("--workers");
+    const auto secondsText = args.removeValueForOption("--seconds");
+    const auto csvPath = args.removeValueForOption("--csv");
+    const bool freeRun = args.removeOptionIfFound("--free-run");
+
+    const int numWorkers = workersText.isNotEmpty() ? workersText.getIntValue() : DeckMixer::getDefaultNumWorkers();
+    const double seconds = secondsText.isNotEmpty() ? secondsText.getDoubleValue() : 2.0;
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    juce::Array<juce::File> files;
+    for (auto& arg : args.arguments)
+        if (!arg.isOption())
+            files.add(juce::File::getCurrentWorkingDirectory().getChildFile(arg.text));
+
+    juce::TemporaryFile temporaryFolder;
+    if (files.isEmpty())
+    {
+        temporaryFolder.getFile().createDirectory();
+        files = synthesiseTestFiles(temporaryFolder.getFile());
+    }
+
+    juce::String csv("file,block,rate,speed,decks,workers,ns_per_sample,ns_per_deck_sample,worst_us,worst_load,misses,allocs_per_callback,max_allocs\n");
+
+    std::cout << juce::String("file").paddedRight(' ', 18) << " block    rate speed decks"
+              << "   ns/smp  ns/deck  worst us  load  miss  allocs/cb  max" << std::endl;
+
+    for (auto& file : files)
+        for (auto blockSize : blockSizes)
+            for (auto sampleRate : sampleRates)
+                for (auto speed : speeds)
+                    for (auto numDecks : deckCounts)
+                    {
+                        Scenario scenario{ file, (int)blockSize, sampleRate, speed, (int)numDecks };
+                        const auto r = runScenario(formatManager, scenario, numWorkers, seconds, freeRun);
+
+                        std::cout << file.getFileName().paddedRight(' ', 18)
+                                  << juce::String((int)blockSize).paddedLeft(' ', 6)
+                                  << juce::String((int)sampleRate).paddedLeft(' ', 8)
+                                  << juce::String(speed, 2).paddedLeft(' ', 6)
+                                  << juce::String((int)numDecks).paddedLeft(' ', 6)
+                                  << juce::String(r.nsPerSample, 1).paddedLeft(' ', 9)
+                                  << juce::String(r.nsPerDeckSample, 1).paddedLeft(' ', 9)
+                                  << juce::String(r.worstCallbackUs, 1).paddedLeft(' ', 10)
+                                  << juce::String(r.worstLoad, 2).paddedLeft(' ', 6)
+                                  << juce::String(r.deadlineMisses).paddedLeft(' ', 6)
+                                  << juce::String(r.allocationsPerCallback, 2).paddedLeft(' ', 11)
+                                  << juce::String((juce::int64)r.maxAllocations).paddedLeft(' ', 5) << std::endl;
+
+                        csv << file.getFileName() << "," << (int)blockSize << "," << (int)sampleRate << ","
+                            << speed << "," << (int)numDecks << "," << numWorkers << ","
+                            << r.nsPerSample << "," << r.nsPerDeckSample << "," << r.worstCallbackUs << ","
+                            << r.worstLoad << "," << r.deadlineMisses << "," << r.allocationsPerCallback << ","
+                            << (juce::int64)r.maxAllocations << "\n";
+                    }
+
+    if (csvPath.isNotEmpty())
+        juce::File::getCurrentWorkingDirectory().getChildFile(csvPath).replaceWithText(csv);
+
+    if (temporaryFolder.getFile().isDirectory())
+        temporaryFolder.getFile().deleteRecursively();
+
+    return 0;
+}
+
+#endif // UNIFIED_AUDIO_BENCHMARK
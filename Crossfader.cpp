@@ -0,0 +1,52 @@
+#include "Crossfader.h"
+
+void Crossfader::setLaw(Law newLaw)
+{
+    // without a curve there's nothing to interpolate
+    if (newLaw == Law::custom && customCurve.size() < 2)
+        return;
+
+    law = newLaw;
+}
+
+bool Crossfader::setCustomCurve(std::vector<float> gains)
+{
+    if (gains.size() < 2)
+        return false;
+
+    customCurve = std::move(gains);
+    law = Law::custom;
+    return true;
+}
+
+void Crossfader::getGains(float position, float& gainA, float& gainB) const
+{
+    position = juce::jlimit(0.0f, 1.0f, position);
+    gainA = getGain(position);
+    gainB = getGain(1.0f - position);
+}
+
+float Crossfader::getGain(float distance) const
+{
+    switch (law)
+    {
+    case Law::linear:
+        return 1.0f - distance;
+
+    case Law::equalPower:
+        return std::cos(distance * juce::MathConstants<float>::halfPi);
+
+    case Law::noDip:
+        return juce::jmin(1.0f, 2.0f * (1.0f - distance));
+
+    case Law::custom:
+    {
+        const float index = distance * (float)(customCurve.size() - 1);
+        const auto i = juce::jmin((size_t)index, customCurve.size() - 2);
+        const float frac = index - (float)i;
+        return customCurve[i] + frac * (customCurve[i + 1] - customCurve[i]);
+    }
+    }
+
+    return 1.0f - distance;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Turns a crossfader position into gains for the two decks either side of
+// it, by one of several laws. Message thread; the mixer ramps the gains it
+// is given, so the law only needs evaluating when the fader moves.
+class Crossfader
+{
+public:
+    enum class Law
+    {
+        linear,      // the gains sum to one; unrelated tracks dip about 3 dB in the middle
+        equalPower,  // sine and cosine, so the total power holds steady through the throw
+        noDip,       // each deck stays at full level across its own half and fades over the other
+        custom       // the table given to setCustomCurve()
+    };
+
+    // Law::custom is ignored until setCustomCurve() has installed a curve.
+    void setLaw(Law newLaw);
+    Law getLaw() const { return law; }
+
+    // A deck's gain at evenly spaced points as the fader moves from its own
+    // end to the far end; the other deck uses the mirror image. Curves of
+    // fewer than two points are rejected; otherwise the law switches to custom.
+    bool setCustomCurve(std::vector<float> gains);
+    const std::vector<float>& getCustomCurve() const { return customCurve; }
+
+    // position runs from 0, all deck A, to 1, all deck B
+    void getGains(float position, float& gainA, float& gainB) const;
+
+private:
+    float getGain(float distance) const;
+
+    Law law = Law::equalPower;
+    std::vector<float> customCurve;
+};
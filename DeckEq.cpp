@@ -0,0 +1,290 @@
+#include "DeckEq.h"
+
+namespace
+{
+    constexpr double lowFrequency = 250.0;
+    constexpr double midFrequency = 1000.0;
+    constexpr double highFrequency = 4000.0;
+    constexpr double coefficientRampSeconds = 0.005;
+
+    // the filter sweeps exponentially between these as the knob turns
+    constexpr double filterLowest = 40.0;
+    constexpr double filterHighest = 18000.0;
+    constexpr float filterDeadZone = 0.02f;
+
+    // RBJ cookbook shelves and peak
+    void makeShelf(bool high, double sampleRate, double frequency, double gainDb, double& b0, double& b1,
+                   double& b2, double& a0, double& a1, double& a2)
+    {
+        const double a = std::pow(10.0, gainDb / 40.0);
+        const double w = juce::MathConstants<double>::twoPi * frequency / sampleRate;
+        const double cosW = std::cos(w);
+        const double alpha = std::sin(w) / 2.0 * std::sqrt(2.0);  // shelf slope of 1
+        const double twoRootAAlpha = 2.0 * std::sqrt(a) * alpha;
+        const double sign = high ? -1.0 : 1.0;
+
+        b0 = a * ((a + 1.0) - sign * (a - 1.0) * cosW + twoRootAAlpha);
+        b1 = sign * 2.0 * a * ((a - 1.0) - sign * (a + 1.0) * cosW);
+        b2 = a * ((a + 1.0) - sign * (a - 1.0) * cosW - twoRootAAlpha);
+        a0 = (a + 1.0) + sign * (a - 1.0) * cosW + twoRootAAlpha;
+        a1 = -sign * 2.0 * ((a - 1.0) + sign * (a + 1.0) * cosW);
+        a2 = (a + 1.0) + sign * (a - 1.0) * cosW - twoRootAAlpha;
+    }
+}
+
+DeckEq::DeckEq()
+{
+    for (auto& gain : bandGains)
+        gain.store(0.0f);
+
+    reset();
+}
+
+void DeckEq::setBandGain(Band band, float decibels)
+{
+    bandGains[(size_t)band].store(juce::jlimit(killDecibels, maxBoostDecibels, decibels));
+}
+
+void DeckEq::setFilter(float position)
+{
+    filterPosition.store(juce::jlimit(-1.0f, 1.0f, position));
+}
+
+void DeckEq::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    rampLength = juce::jmax(1, juce::roundToInt(sampleRate * coefficientRampSeconds));
+    reset();
+}
+
+void DeckEq::reset()
+{
+    for (int stage = 0; stage < numStages; ++stage)
+    {
+        targets[(size_t)stage] = {};
+        b0[stage] = 1.0f;
+        b1[stage] = b2[stage] = a1[stage] = a2[stage] = 0.0f;
+        b0Step[stage] = b1Step[stage] = b2Step[stage] = a1Step[stage] = a2Step[stage] = 0.0f;
+
+        for (int channel = 0; channel < maxChannels; ++channel)
+            z1[stage][channel] = z2[stage][channel] = 0.0f;
+    }
+
+    active.fill(false);
+    appliedGains.fill(0.0f);
+    appliedFilter = 0.0f;
+    rampRemaining = 0;
+
+    // jump straight to whatever the controls are set to
+    if (sampleRate > 0.0)
+    {
+        updateTargets();
+
+        for (int stage = 0; stage < numStages; ++stage)
+        {
+            const auto& t = targets[(size_t)stage];
+            b0[stage] = t.b0; b1[stage] = t.b1; b2[stage] = t.b2; a1[stage] = t.a1; a2[stage] = t.a2;
+            b0Step[stage] = b1Step[stage] = b2Step[stage] = a1Step[stage] = a2Step[stage] = 0.0f;
+        }
+
+        rampRemaining = 0;
+    }
+}
+
+DeckEq::Coefficients DeckEq::makeFilter(bool highPass, double frequency, double q) const
+{
+    const double w = juce::MathConstants<double>::twoPi * juce::jmin(frequency, sampleRate * 0.45) / sampleRate;
+    const double cosW = std::cos(w);
+    const double alpha = std::sin(w) / (2.0 * q);
+    const double a0 = 1.0 + alpha;
+
+    Coefficients c;
+    c.b1 = (float)((highPass ? -(1.0 + cosW) : (1.0 - cosW)) / a0);
+    c.b0 = c.b2 = (float)((highPass ? (1.0 + cosW) : (1.0 - cosW)) / 2.0 / a0);
+    c.a1 = (float)(-2.0 * cosW / a0);
+    c.a2 = (float)((1.0 - alpha) / a0);
+    return c;
+}
+
+void DeckEq::setTarget(int stage, const Coefficients& c)
+{
+    targets[(size_t)stage] = c;
+
+    // a flat stage can only be skipped once it has glided back to flat
+    const bool flat = c.b0 == 1.0f && c.b1 == 0.0f && c.b2 == 0.0f && c.a1 == 0.0f && c.a2 == 0.0f;
+    const bool wasFlat = b0[stage] == 1.0f && b1[stage] == 0.0f && b2[stage] == 0.0f && a1[stage] == 0.0f && a2[stage] == 0.0f;
+
+    if (!flat && wasFlat)
+    {
+        // starting from silence in the state, so nothing carries over
+        for (int channel = 0; channel < maxChannels; ++channel)
+            z1[stage][channel] = z2[stage][channel] = 0.0f;
+    }
+
+    active[(size_t)stage] = !(flat && wasFlat);
+}
+
+void DeckEq::updateTargets()
+{
+    for (int band = 0; band < 3; ++band)
+    {
+        const float gain = appliedGains[(size_t)band];
+        const int stage = band == 0 ? lowShelf : (band == 1 ? midPeak : highShelf);
+
+        if (gain == 0.0f)
+        {
+            setTarget(stage, {});
+            continue;
+        }
+
+        double b0d, b1d, b2d, a0d, a1d, a2d;
+
+        if (band == 1)
+        {
+            const double a = std::pow(10.0, gain / 40.0);
+            const double w = juce::MathConstants<double>::twoPi * midFrequency / sampleRate;
+            const double alpha = std::sin(w) / (2.0 * 0.7);
+            b0d = 1.0 + alpha * a;
+            b1d = -2.0 * std::cos(w);
+            b2d = 1.0 - alpha * a;
+            a0d = 1.0 + alpha / a;
+            a1d = b1d;
+            a2d = 1.0 - alpha / a;
+        }
+        else
+        {
+            makeShelf(band == 2, sampleRate, band == 2 ? highFrequency : lowFrequency, gain,
+                      b0d, b1d, b2d, a0d, a1d, a2d);
+        }
+
+        setTarget(stage, { (float)(b0d / a0d), (float)(b1d / a0d), (float)(b2d / a0d),
+                           (float)(a1d / a0d), (float)(a2d / a0d) });
+    }
+
+    // two Butterworth sections make a 24 dB/oct Linkwitz-Riley slope
+    if (std::abs(appliedFilter) < filterDeadZone)
+    {
+        setTarget(filterA, {});
+        setTarget(filterB, {});
+    }
+    else
+    {
+        const bool highPass = appliedFilter > 0.0f;
+        const double amount = (std::abs(appliedFilter) - filterDeadZone) / (1.0 - filterDeadZone);
+        const double frequency = highPass ? filterLowest * std::pow(filterHighest / filterLowest, amount)
+                                          : filterHighest * std::pow(filterLowest / filterHighest, amount);
+        const auto c = makeFilter(highPass, frequency, juce::MathConstants<double>::sqrt2 * 0.5);
+        setTarget(filterA, c);
+        setTarget(filterB, c);
+    }
+
+    // glide every stage from where it is to its target
+    rampRemaining = rampLength;
+    const float scale = 1.0f / (float)rampLength;
+
+    for (int stage = 0; stage < numStages; ++stage)
+    {
+        const auto& t = targets[(size_t)stage];
+        b0Step[stage] = (t.b0 - b0[stage]) * scale;
+        b1Step[stage] = (t.b1 - b1[stage]) * scale;
+        b2Step[stage] = (t.b2 - b2[stage]) * scale;
+        a1Step[stage] = (t.a1 - a1[stage]) * scale;
+        a2Step[stage] = (t.a2 - a2[stage]) * scale;
+    }
+}
+
+void DeckEq::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    if (sampleRate <= 0.0)
+        return;
+
+    bool changed = false;
+    for (int band = 0; band < 3; ++band)
+    {
+        const float gain = bandGains[(size_t)band].load(std::memory_order_relaxed);
+        changed = changed || gain != appliedGains[(size_t)band];
+        appliedGains[(size_t)band] = gain;
+    }
+
+    const float filter = filterPosition.load(std::memory_order_relaxed);
+    changed = changed || filter != appliedFilter;
+    appliedFilter = filter;
+
+    if (changed)
+        updateTargets();
+
+    // only the stages doing something, in order
+    int stages[numStages];
+    int numActive = 0;
+    for (int stage = 0; stage < numStages; ++stage)
+        if (active[(size_t)stage])
+            stages[numActive++] = stage;
+
+    if (numActive == 0)
+        return;
+
+    const int numChannels = juce::jmin(maxChannels, buffer.getNumChannels());
+    float* data[maxChannels] = {};
+    for (int channel = 0; channel < numChannels; ++channel)
+        data[channel] = buffer.getWritePointer(channel, startSample);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float x[maxChannels] = {};
+        for (int channel = 0; channel < numChannels; ++channel)
+            x[channel] = data[channel][i];
+
+        for (int s = 0; s < numActive; ++s)
+        {
+            const int stage = stages[s];
+
+            for (int channel = 0; channel < maxChannels; ++channel)
+            {
+                const float y = b0[stage] * x[channel] + z1[stage][channel];
+                z1[stage][channel] = b1[stage] * x[channel] - a1[stage] * y + z2[stage][channel];
+                z2[stage][channel] = b2[stage] * x[channel] - a2[stage] * y;
+                x[channel] = y;
+            }
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            data[channel][i] = x[channel];
+
+        if (rampRemaining > 0)
+        {
+            for (int s = 0; s < numActive; ++s)
+            {
+                const int stage = stages[s];
+                b0[stage] += b0Step[stage];
+                b1[stage] += b1Step[stage];
+                b2[stage] += b2Step[stage];
+                a1[stage] += a1Step[stage];
+                a2[stage] += a2Step[stage];
+            }
+
+            if (--rampRemaining == 0)
+            {
+                // land exactly, and drop the stages that have gone flat
+                for (int stage = 0; stage < numStages; ++stage)
+                {
+                    const auto& t = targets[(size_t)stage];
+                    b0[stage] = t.b0; b1[stage] = t.b1; b2[stage] = t.b2; a1[stage] = t.a1; a2[stage] = t.a2;
+                    setTarget(stage, t);
+                }
+
+                numActive = 0;
+                for (int stage = 0; stage < numStages; ++stage)
+                    if (active[(size_t)stage])
+                        stages[numActive++] = stage;
+            }
+        }
+    }
+
+    // keep denormals out of the state once the input goes quiet
+    for (int stage = 0; stage < numStages; ++stage)
+        for (int channel = 0; channel < maxChannels; ++channel)
+        {
+            if (std::abs(z1[stage][channel]) < 1.0e-15f) z1[stage][channel] = 0.0f;
+            if (std::abs(z2[stage][channel]) < 1.0e-15f) z2[stage][channel] = 0.0f;
+        }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <JuceHeader.h>
+
+// A deck's mixing EQ: a three-band kill EQ (low shelf, mid peak, high shelf,
+// each down to -40 dB) followed by a one-knob filter that sweeps a 24 dB/oct
+// low-pass to the left of centre and a high-pass to the right.
+//
+// It's a cascade of biquads kept as structure-of-arrays: one coefficient
+// array per term across the stages, and the filter state per stage with the
+// channels side by side, so the inner loop over channels is a straight
+// vector operation. When a control moves, the coefficients glide to their
+// new values over a few milliseconds instead of jumping, and any stage
+// that's flat is skipped, so a deck with the EQ untouched costs nothing.
+class DeckEq
+{
+public:
+    enum class Band
+    {
+        low,
+        mid,
+        high
+    };
+
+    static constexpr int maxChannels = 2;
+    static constexpr float killDecibels = -40.0f;
+    static constexpr float maxBoostDecibels = 6.0f;
+
+    DeckEq();
+
+    // Message thread; the audio thread picks the values up at its next block.
+    void setBandGain(Band band, float decibels);
+    float getBandGain(Band band) const { return bandGains[(size_t)band].load(); }
+
+    // -1 is the low-pass fully closed, 0 is off, 1 the high-pass fully closed
+    void setFilter(float position);
+    float getFilter() const { return filterPosition.load(); }
+
+    // Audio thread.
+    void prepare(double sampleRate);
+    void reset();
+    void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+private:
+    enum Stage
+    {
+        lowShelf,
+        midPeak,
+        highShelf,
+        filterA,
+        filterB,
+        numStages
+    };
+
+    struct Coefficients
+    {
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+    };
+
+    void updateTargets();
+    void setTarget(int stage, const Coefficients& c);
+    Coefficients makeFilter(bool highPass, double frequency, double q) const;
+
+    std::array<std::atomic<float>, 3> bandGains;
+    std::atomic<float> filterPosition{ 0.0f };
+
+    double sampleRate = 0.0;
+    int rampLength = 1;
+
+    // the values targets were last worked out from
+    std::array<float, 3> appliedGains{};
+    float appliedFilter = 0.0f;
+
+    // coefficients, one array per term
+    alignas(16) float b0[numStages], b1[numStages], b2[numStages], a1[numStages], a2[numStages];
+    alignas(16) float b0Step[numStages], b1Step[numStages], b2Step[numStages], a1Step[numStages], a2Step[numStages];
+    std::array<Coefficients, numStages> targets;
+    int rampRemaining = 0;
+
+    // transposed direct form II state, channels side by side
+    alignas(16) float z1[numStages][maxChannels], z2[numStages][maxChannels];
+
+    std::array<bool, numStages> active{};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckEq)
+};
@@ -0,0 +1,240 @@
+#include "DeckMixer.h"
+#include "AudioProfiler.h"
+
+class DeckMixer::Worker : public juce::Thread
+{
+public:
+    Worker(DeckMixer& m, int index)
+        : juce::Thread("Deck Mixer " + juce::String(index)),
+          mixer(m)
+    {
+    }
+
+    void run() override
+    {
+        auto seen = (juce::uint32)(mixer.claimWord.load() >> 32);
+
+        while (!threadShouldExit())
+        {
+            // Spin for part of a block period after each job, since the next
+            // one is probably about to arrive; after that, sleep until the
+            // callback wakes us, so idle decks don't burn a core each.
+            const auto spinUntil = juce::Time::getMillisecondCounterHiRes() + mixer.spinMilliseconds.load();
+
+            while ((juce::uint32)(mixer.claimWord.load(std::memory_order_acquire) >> 32) == seen)
+            {
+                if (threadShouldExit())
+                    return;
+
+                if (juce::Time::getMillisecondCounterHiRes() < spinUntil)
+                {
+                    juce::Thread::yield();
+                    continue;
+                }
+
+                sleeping.store(true);
+                if ((juce::uint32)(mixer.claimWord.load() >> 32) == seen)
+                    wakeUp.wait(100);
+                sleeping.store(false);
+            }
+
+            seen = (juce::uint32)(mixer.claimWord.load(std::memory_order_acquire) >> 32);
+            mixer.claimAndRender(seen);
+        }
+    }
+
+    DeckMixer& mixer;
+    juce::WaitableEvent wakeUp;
+    std::atomic<bool> sleeping{ false };
+};
+
+DeckMixer::DeckMixer(int numWorkerThreads)
+{
+    for (int i = 0; i < numWorkerThreads; ++i)
+    {
+        auto* worker = workers.add(new Worker(*this, i + 1));
+
+        // real-time scheduling needs privileges some systems don't grant
+        if (!worker->startRealtimeThread(juce::Thread::RealtimeOptions{}))
+            worker->startThread(juce::Thread::Priority::highest);
+    }
+}
+
+DeckMixer::~DeckMixer()
+{
+    for (auto* worker : workers)
+        worker->signalThreadShouldExit();
+
+    for (auto* worker : workers)
+    {
+        worker->wakeUp.signal();
+        worker->stopThread(1000);
+    }
+}
+
+int DeckMixer::addDeck(juce::AudioSource* source, float gain)
+{
+    jassert(source != nullptr);
+
+    int index = 0;
+    while (index < maxDecks && decks[index].source.load() != nullptr)
+        ++index;
+
+    if (index == maxDecks)
+        return -1;
+
+    if (prepared.load())
+        source->prepareToPlay(preparedBlockSize, preparedSampleRate);
+
+    decks[index].gain.store(gain);
+    decks[index].source.store(source);
+
+    if (index >= numSlots.load())
+        numSlots.store(index + 1);
+
+    return index;
+}
+
+void DeckMixer::removeDeck(juce::AudioSource* source)
+{
+    for (auto& deck : decks)
+    {
+        if (deck.source.load() != source)
+            continue;
+
+        deck.source.store(nullptr);
+
+        // a block that picked the source up before we cleared it may still be
+        // rendering it, so let two block boundaries pass
+        const auto target = blocksRendered.load() + 2;
+        const auto startTime = juce::Time::getMillisecondCounter();
+        while (prepared.load() && blocksRendered.load() < target
+               && juce::Time::getMillisecondCounter() - startTime < 500)
+            juce::Thread::sleep(1);
+    }
+}
+
+void DeckMixer::setDeckGain(int index, float gain)
+{
+    if (juce::isPositiveAndBelow(index, maxDecks))
+        decks[index].gain.store(gain, std::memory_order_relaxed);
+}
+
+void DeckMixer::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    preparedBlockSize = samplesPerBlockExpected;
+    preparedSampleRate = sampleRate;
+    spinMilliseconds.store(0.5 * 1000.0 * samplesPerBlockExpected / sampleRate);
+
+    for (auto& deck : decks)
+    {
+        deck.scratch.setSize(numChannels, samplesPerBlockExpected);
+        deck.gainRamp.reset(sampleRate, GainRamp::defaultRampSeconds, deck.gain.load());
+
+        if (auto* source = deck.source.load())
+            source->prepareToPlay(samplesPerBlockExpected, sampleRate);
+    }
+
+    prepared.store(true);
+}
+
+void DeckMixer::releaseResources()
+{
+    prepared.store(false);
+
+    for (auto& deck : decks)
+        if (auto* source = deck.source.load())
+            source->releaseResources();
+}
+
+void DeckMixer::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    if (!prepared.load(std::memory_order_relaxed) || preparedBlockSize <= 0)
+    {
+        bufferToFill.clearActiveBufferRegion();
+        return;
+    }
+
+    // the device may hand us more samples than it announced, so render in
+    // chunks of the pre-allocated scratch size rather than growing it here
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        const int chunk = juce::jmin(bufferToFill.numSamples - done, preparedBlockSize);
+        renderChunk(juce::AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, chunk));
+        done += chunk;
+    }
+
+    blocksRendered.fetch_add(1);
+}
+
+void DeckMixer::renderChunk(const juce::AudioSourceChannelInfo& info)
+{
+    const int slots = numSlots.load(std::memory_order_acquire);
+
+    // publish the job; the parameters have to be in place before the claim
+    // word makes the new generation visible
+    jobNumSamples.store(info.numSamples, std::memory_order_relaxed);
+    jobNumSlots.store(slots, std::memory_order_relaxed);
+    decksFinished.store(0, std::memory_order_relaxed);
+    ++generation;
+
+    // Sequentially consistent, not just release: a worker going to sleep
+    // stores 'sleeping' and then loads the claim word, and we store the
+    // claim word and then load 'sleeping'. Only a total order guarantees at
+    // least one side sees the other, so a worker can't miss the generation
+    // and sleep through the block.
+    claimWord.store((juce::uint64)generation << 32);
+
+    for (auto* worker : workers)
+        if (worker->sleeping.load())
+            worker->wakeUp.signal();
+
+    claimAndRender(generation);
+
+    // only decks that a worker has already claimed can be outstanding here
+    while (decksFinished.load(std::memory_order_acquire) < slots)
+        juce::Thread::yield();
+
+    AudioProfiler::ScopedStage stage(AudioProfiler::Stage::mix);
+
+    const int outputChannels = juce::jmin(info.buffer->getNumChannels(), numChannels);
+    info.clearActiveBufferRegion();
+
+    for (int index = 0; index < slots; ++index)
+    {
+        auto& deck = decks[index];
+        if (!deck.rendered)
+            continue;
+
+        deck.gainRamp.setTarget(deck.gain.load(std::memory_order_relaxed));
+        deck.gainRamp.addFrom(*info.buffer, info.startSample, deck.scratch, 0, info.numSamples, outputChannels);
+    }
+}
+
+void DeckMixer::claimAndRender(juce::uint32 jobGeneration)
+{
+    auto word = claimWord.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        const auto wordGeneration = (juce::uint32)(word >> 32);
+        const auto index = (int)(word & 0xffffffff);
+
+        if (wordGeneration != jobGeneration || index >= jobNumSlots.load(std::memory_order_relaxed))
+            return;
+
+        if (!claimWord.compare_exchange_weak(word, word + 1, std::memory_order_acq_rel))
+            continue;
+
+        auto& deck = decks[index];
+        auto* source = deck.source.load(std::memory_order_acquire);
+        deck.rendered = source != nullptr;
+
+        if (source != nullptr)
+            source->getNextAudioBlock(juce::AudioSourceChannelInfo(&deck.scratch, 0,
+                                                                   jobNumSamples.load(std::memory_order_relaxed)));
+
+        decksFinished.fetch_add(1, std::memory_order_release);
+        word = claimWord.load(std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <JuceHeader.h>
+#include "GainRamp.h"
+
+// Sums any number of deck sources into the output, rendering the decks in
+// parallel. Each block, the audio callback publishes a job and then claims
+// decks one at a time alongside a small pool of worker threads; whichever
+// thread claims a deck renders it into that deck's own scratch buffer. The
+// callback only ever waits for decks a worker has actually started on, so a
+// worker that is asleep or descheduled costs nothing but parallelism.
+//
+// Nothing is allocated or locked on the audio path: the scratch buffers are
+// sized in prepareToPlay, and claims are a compare-and-swap on one word.
+// Deck gains glide to each new value, and are applied while summing.
+class DeckMixer : public juce::AudioSource
+{
+public:
+    static constexpr int maxDecks = 16;
+
+    explicit DeckMixer(int numWorkerThreads = getDefaultNumWorkers());
+    ~DeckMixer() override;
+
+    // Message thread. The source is prepared first if the mixer is already
+    // running. Returns the deck's index, or -1 if all the slots are taken.
+    int addDeck(juce::AudioSource* source, float gain = 1.0f);
+
+    // Message thread. Returns once the audio thread has stopped rendering the
+    // source, so the caller can delete it.
+    void removeDeck(juce::AudioSource* source);
+
+    void setDeckGain(int index, float gain);
+    int getNumWorkers() const { return workers.size(); }
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    static int getDefaultNumWorkers() { return juce::jlimit(0, 3, juce::SystemStats::getNumCpus() - 1); }
+
+private:
+    class Worker;
+
+    struct Deck
+    {
+        std::atomic<juce::AudioSource*> source{ nullptr };
+        std::atomic<float> gain{ 1.0f };
+
+        // written by whichever thread rendered the deck this block
+        juce::AudioBuffer<float> scratch;
+        bool rendered = false;
+
+        // audio thread, following gain
+        GainRamp gainRamp;
+    };
+
+    void renderChunk(const juce::AudioSourceChannelInfo& info);
+    void claimAndRender(juce::uint32 generation);
+
+    static constexpr int numChannels = 2;
+
+    Deck decks[maxDecks];
+    std::atomic<int> numSlots{ 0 };
+    juce::OwnedArray<Worker> workers;
+
+    // the current job: a generation in the top half of the word and the next
+    // unclaimed deck in the bottom half, so a late claim can't leak into the
+    // following block
+    std::atomic<juce::uint64> claimWord{ 0 };
+    std::atomic<int> jobNumSamples{ 0 };
+    std::atomic<int> jobNumSlots{ 0 };
+    std::atomic<int> decksFinished{ 0 };
+    juce::uint32 generation = 0;
+
+    std::atomic<bool> prepared{ false };
+    std::atomic<juce::uint32> blocksRendered{ 0 };
+    std::atomic<double> spinMilliseconds{ 1.0 };
+    int preparedBlockSize = 0;
+    double preparedSampleRate = 0.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DeckMixer)
+};
@@ -0,0 +1,243 @@
+#include "DecodedAudioCache.h"
+
+// Reads a file's samples chunk by chunk out of the cache, decoding through
+// the reader it wraps on a miss. Like any reader, use it from one thread at
+// a time; the cache itself is shared.
+class DecodedAudioCache::CachedReader : public juce::AudioFormatReader
+{
+public:
+    CachedReader(juce::AudioFormatReader* sourceReader, juce::uint64 key)
+        : juce::AudioFormatReader(nullptr, sourceReader->getFormatName()),
+          source(sourceReader),
+          fileKey(key)
+    {
+        sampleRate = source->sampleRate;
+        bitsPerSample = 32;
+        lengthInSamples = source->lengthInSamples;
+        numChannels = source->numChannels;
+        usesFloatingPointData = true;
+        metadataValues = source->metadataValues;
+    }
+
+    bool readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                     juce::int64 startSampleInFile, int numSamples) override
+    {
+        clearSamplesBeyondAvailableLength(destChannels, numDestChannels, startOffsetInDestBuffer,
+                                          startSampleInFile, numSamples, lengthInSamples);
+
+        for (int done = 0; done < numSamples;)
+        {
+            const auto position = startSampleInFile + done;
+            const auto chunkIndex = position / chunkSamples;
+            const int offset = (int)(position % chunkSamples);
+            const int destOffset = startOffsetInDestBuffer + done;
+
+            auto* chunk = cache->acquire(fileKey, chunkIndex, *source);
+            if (chunk == nullptr)
+            {
+                // every block is busy; decode this part directly instead
+                float* dest[maxChannels] = {};
+                for (int channel = 0; channel < juce::jmin(numDestChannels, (int)numChannels); ++channel)
+                    if (destChannels[channel] != nullptr)
+                        dest[channel] = reinterpret_cast<float*>(destChannels[channel]) + destOffset;
+
+                return source->read(dest, (int)numChannels, position, numSamples - done);
+            }
+
+            const int count = juce::jmin(numSamples - done, chunk->numSamples - offset);
+
+            for (int channel = 0; channel < numDestChannels; ++channel)
+            {
+                auto* dest = reinterpret_cast<float*>(destChannels[channel]);
+                if (dest == nullptr)
+                    continue;
+
+                if (channel < (int)numChannels && count > 0)
+                    juce::FloatVectorOperations::copy(dest + destOffset,
+                                                      chunk->data.get() + channel * chunkSamples + offset, count);
+                else if (count > 0)
+                    juce::FloatVectorOperations::clear(dest + destOffset, count);
+            }
+
+            cache->release(chunk);
+
+            if (count <= 0)
+                return false; // the decoder came up short of the length it reported
+
+            done += count;
+        }
+
+        return true;
+    }
+
+private:
+    juce::SharedResourcePointer<DecodedAudioCache> cache;
+    std::unique_ptr<juce::AudioFormatReader> source;
+    const juce::uint64 fileKey;
+};
+
+//==============================================================================
+DecodedAudioCache::DecodedAudioCache()
+{
+    setMemoryBudget(defaultBudget);
+}
+
+DecodedAudioCache::~DecodedAudioCache()
+{
+    // readers hold a reference, so none can still be using a chunk
+    jassert(std::all_of(chunks.begin(), chunks.end(), [](const Chunk& c) { return c.pins == 0; }));
+}
+
+juce::AudioFormatReader* DecodedAudioCache::createReaderFor(juce::AudioFormatManager& formatManager,
+                                                            const juce::File& file)
+{
+    auto* reader = seekIndex->createReaderFor(formatManager, file);
+    if (reader == nullptr || reader->numChannels > (unsigned int)maxChannels || reader->lengthInSamples <= 0)
+        return reader;
+
+    // PCM is cheaper to read again than to keep a second copy of, and the OS
+    // caches the file anyway; only formats with a decoder are worth holding
+    for (int i = 0; i < formatManager.getNumKnownFormats(); ++i)
+    {
+        auto* format = formatManager.getKnownFormat(i);
+        if (format->getFormatName() == reader->getFormatName() && !format->isCompressed())
+            return reader;
+    }
+
+    return new CachedReader(reader, getFileKey(file));
+}
+
+void DecodedAudioCache::setMemoryBudget(size_t numBytes)
+{
+    const juce::ScopedLock sl(lock);
+    budgetBlocks = juce::jmax((size_t)1, numBytes / blockBytes);
+    trimToBudget();
+}
+
+size_t DecodedAudioCache::getMemoryBudget() const
+{
+    const juce::ScopedLock sl(lock);
+    return budgetBlocks * blockBytes;
+}
+
+size_t DecodedAudioCache::getMemoryUsed() const
+{
+    const juce::ScopedLock sl(lock);
+    return numBlocks * blockBytes;
+}
+
+const DecodedAudioCache::Chunk* DecodedAudioCache::acquire(juce::uint64 fileKey, juce::int64 chunkIndex,
+                                                           juce::AudioFormatReader& source)
+{
+    const Key key{ fileKey, chunkIndex };
+    std::unique_ptr<float[]> block;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        auto found = index.find(key);
+        if (found != index.end())
+        {
+            chunks.splice(chunks.begin(), chunks, found->second);
+            ++found->second->pins;
+            ++hits;
+            return &*found->second;
+        }
+
+        block = takeBlock();
+        if (block == nullptr)
+            return nullptr;
+    }
+
+    ++misses;
+
+    // decode outside the lock, so other decks' hits don't wait for it
+    const auto start = chunkIndex * chunkSamples;
+    const int numSamples = (int)juce::jlimit((juce::int64)0, (juce::int64)chunkSamples, source.lengthInSamples - start);
+    float* dest[maxChannels] = { block.get(), block.get() + chunkSamples };
+    source.read(dest, (int)source.numChannels, start, numSamples);
+
+    const juce::ScopedLock sl(lock);
+
+    // another reader may have decoded the same chunk in the meantime
+    auto found = index.find(key);
+    if (found != index.end())
+    {
+        freeBlocks.push_back(std::move(block));
+        chunks.splice(chunks.begin(), chunks, found->second);
+        ++found->second->pins;
+        return &*found->second;
+    }
+
+    chunks.emplace_front();
+    auto& chunk = chunks.front();
+    chunk.key = key;
+    chunk.data = std::move(block);
+    chunk.numSamples = numSamples;
+    chunk.pins = 1;
+    index[key] = chunks.begin();
+    return &chunk;
+}
+
+void DecodedAudioCache::release(const Chunk* chunk)
+{
+    const juce::ScopedLock sl(lock);
+    --const_cast<Chunk*>(chunk)->pins;
+}
+
+std::unique_ptr<float[]> DecodedAudioCache::takeBlock()
+{
+    if (!freeBlocks.empty())
+    {
+        auto block = std::move(freeBlocks.back());
+        freeBlocks.pop_back();
+        return block;
+    }
+
+    if (numBlocks < budgetBlocks)
+    {
+        ++numBlocks;
+        return std::make_unique<float[]>((size_t)chunkSamples * maxChannels);
+    }
+
+    for (auto chunk = chunks.rbegin(); chunk != chunks.rend(); ++chunk)
+    {
+        if (chunk->pins > 0)
+            continue;
+
+        auto block = std::move(chunk->data);
+        index.erase(chunk->key);
+        chunks.erase(std::next(chunk).base());
+        return block;
+    }
+
+    return nullptr;
+}
+
+void DecodedAudioCache::trimToBudget()
+{
+    while (numBlocks > budgetBlocks && !freeBlocks.empty())
+    {
+        freeBlocks.pop_back();
+        --numBlocks;
+    }
+
+    // least recently used first, skipping whatever a reader has pinned
+    for (auto chunk = chunks.end(); chunk != chunks.begin() && numBlocks > budgetBlocks;)
+    {
+        --chunk;
+        if (chunk->pins > 0)
+            continue;
+
+        index.erase(chunk->key);
+        chunk = chunks.erase(chunk);
+        --numBlocks;
+    }
+}
+
+juce::uint64 DecodedAudioCache::getFileKey(const juce::File& file)
+{
+    // a file that's been rewritten gets a new key, so stale audio just ages out
+    return (juce::uint64)(file.getFullPathName() + "|" + juce::String(file.getSize()) + "|"
+                          + juce::String(file.getLastModificationTime().toMilliseconds())).hashCode64();
+}
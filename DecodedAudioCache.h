@@ -0,0 +1,78 @@
+#pragma once
+#include <JuceHeader.h>
+#include <list>
+#include <map>
+#include "SeekIndex.h"
+
+// Process-wide cache of decoded PCM for compressed files, shared by every
+// deck. Files are decoded in fixed-size chunks into blocks from a pool that
+// is capped by a memory budget; when it's full the least recently used chunk
+// gives up its block. Hold one through juce::SharedResourcePointer.
+//
+// Readers from createReaderFor() read through the cache, so replaying a
+// track, jumping back to a cue or loading it on the other deck copies from
+// RAM instead of running the decoder again.
+class DecodedAudioCache
+{
+public:
+    DecodedAudioCache();
+    ~DecodedAudioCache();
+
+    // Opens the file with the format manager, seeking with the file's
+    // SeekIndex table if it has one, and if it's a compressed format the
+    // cache can hold, wraps the reader so that reads go through the cache.
+    // The caller owns the result, which may be null.
+    juce::AudioFormatReader* createReaderFor(juce::AudioFormatManager& formatManager, const juce::File& file);
+
+    void setMemoryBudget(size_t numBytes);
+    size_t getMemoryBudget() const;
+    size_t getMemoryUsed() const;
+
+    juce::uint64 getNumHits() const { return hits.load(); }
+    juce::uint64 getNumMisses() const { return misses.load(); }
+
+    static constexpr int chunkSamples = 1 << 16;
+    static constexpr int maxChannels = 2;
+
+private:
+    class CachedReader;
+
+    using Key = std::pair<juce::uint64, juce::int64>;
+
+    struct Chunk
+    {
+        Key key;
+        std::unique_ptr<float[]> data; // planar, chunkSamples per channel
+        int numSamples = 0;
+        int pins = 0;
+    };
+
+    using ChunkList = std::list<Chunk>;
+
+    // Returns the chunk pinned, decoding it from source on a miss, or null
+    // if every block is pinned. Pair each non-null result with release().
+    const Chunk* acquire(juce::uint64 fileKey, juce::int64 index, juce::AudioFormatReader& source);
+    void release(const Chunk* chunk);
+
+    std::unique_ptr<float[]> takeBlock();
+    void trimToBudget();
+
+    static juce::uint64 getFileKey(const juce::File& file);
+
+    juce::SharedResourcePointer<SeekIndex> seekIndex;
+
+    juce::CriticalSection lock;
+    ChunkList chunks; // most recently used first
+    std::map<Key, ChunkList::iterator> index;
+    std::vector<std::unique_ptr<float[]>> freeBlocks;
+    size_t numBlocks = 0;
+    size_t budgetBlocks = 0;
+
+    std::atomic<juce::uint64> hits{ 0 };
+    std::atomic<juce::uint64> misses{ 0 };
+
+    static constexpr size_t blockBytes = (size_t)chunkSamples * maxChannels * sizeof(float);
+    static constexpr size_t defaultBudget = (size_t)256 * 1024 * 1024;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DecodedAudioCache)
+};
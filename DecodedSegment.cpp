@@ -0,0 +1,86 @@
+#include "DecodedSegment.h"
+#include "DecodedAudioCache.h"
+
+std::shared_ptr<DecodedSegment> DecodedSegment::decode(juce::AudioFormatManager& formatManager,
+                                                       const juce::File& file,
+                                                       juce::int64 startSample,
+                                                       juce::int64 endSample,
+                                                       double deviceSampleRate)
+{
+    juce::SharedResourcePointer<DecodedAudioCache> decodedCache;
+    std::unique_ptr<juce::AudioFormatReader> reader(decodedCache->createReaderFor(formatManager, file));
+    if (reader == nullptr || deviceSampleRate <= 0.0 || endSample <= startSample)
+        return nullptr;
+
+    const auto numOutput = (int)(endSample - startSample);
+    const double ratio = reader->sampleRate / deviceSampleRate;
+
+    auto segment = std::make_shared<DecodedSegment>();
+    segment->startSample = startSample;
+    segment->sampleRate = deviceSampleRate;
+    segment->audio.setSize(numChannels, numOutput);
+
+    if (ratio == 1.0)
+    {
+        reader->read(&segment->audio, 0, numOutput, startSample, true, true);
+        return segment;
+    }
+
+    // a few extra input samples cover the interpolator's look-ahead
+    const auto fileStart = (juce::int64)std::floor((double)startSample * ratio);
+    const auto numInput = (int)std::ceil(numOutput * ratio) + 8;
+
+    juce::AudioBuffer<float> fileAudio(numChannels, numInput);
+    reader->read(&fileAudio, 0, numInput, fileStart, true, true);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        juce::LagrangeInterpolator interpolator;
+        interpolator.process(ratio, fileAudio.getReadPointer(channel), segment->audio.getWritePointer(channel), numOutput);
+    }
+
+    return segment;
+}
+
+std::shared_ptr<DecodedSegment> DecodedSegment::decodeLoop(juce::AudioFormatManager& formatManager,
+                                                           const juce::File& file,
+                                                           juce::int64 startSample,
+                                                           juce::int64 endSample,
+                                                           double deviceSampleRate,
+                                                           int crossfadeSamples)
+{
+    const auto length = endSample - startSample;
+    const auto fadeLength = (int)juce::jmin((juce::int64)crossfadeSamples, startSample, length / 2);
+
+    auto withPreRoll = decode(formatManager, file, startSample - fadeLength, endSample, deviceSampleRate);
+    if (withPreRoll == nullptr || fadeLength <= 0)
+        return withPreRoll;
+
+    auto segment = std::make_shared<DecodedSegment>();
+    segment->startSample = startSample;
+    segment->sampleRate = deviceSampleRate;
+    segment->audio.setSize(numChannels, (int)length);
+
+    const int tailStart = (int)length - fadeLength;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const float* preRoll = withPreRoll->audio.getReadPointer(channel);
+        const float* region = preRoll + fadeLength;
+        float* dest = segment->audio.getWritePointer(channel);
+
+        juce::FloatVectorOperations::copy(dest, region, tailStart);
+
+        // equal-power blend of the loop's tail into the audio leading up to
+        // its start, which is what naturally follows the last sample we play
+        for (int i = 0; i < fadeLength; ++i)
+        {
+            const float t = ((float)i + 0.5f) / (float)fadeLength;
+            const float fadeOut = std::cos(t * juce::MathConstants<float>::halfPi);
+            const float fadeIn = std::sin(t * juce::MathConstants<float>::halfPi);
+            dest[tailStart + i] = region[tailStart + i] * fadeOut + preRoll[i] * fadeIn;
+        }
+    }
+
+    return segment;
+}
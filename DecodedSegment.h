@@ -0,0 +1,36 @@
+#pragma once
+#include <JuceHeader.h>
+
+// A stretch of a track decoded into RAM at the rate its transport runs at, so
+// the audio thread can play it without touching the disk or a decoder.
+// Positions are on the transport's timeline, i.e. in samples at sampleRate.
+struct DecodedSegment
+{
+    juce::AudioBuffer<float> audio;
+    juce::int64 startSample = 0;
+    double sampleRate = 0.0;
+
+    int getNumSamples() const { return audio.getNumSamples(); }
+    juce::int64 getEndSample() const { return startSample + audio.getNumSamples(); }
+
+    // Decodes [startSample, endSample) of the file, resampling to
+    // deviceSampleRate if the file runs at a different rate. Blocks on disk
+    // and decoder work, so call it from a background thread.
+    static std::shared_ptr<DecodedSegment> decode(juce::AudioFormatManager& formatManager,
+                                                  const juce::File& file,
+                                                  juce::int64 startSample,
+                                                  juce::int64 endSample,
+                                                  double deviceSampleRate);
+
+    // Like decode(), but the last crossfadeSamples of the region are blended
+    // into the audio that precedes startSample, so playing it on repeat wraps
+    // from the end back to the start without a click.
+    static std::shared_ptr<DecodedSegment> decodeLoop(juce::AudioFormatManager& formatManager,
+                                                      const juce::File& file,
+                                                      juce::int64 startSample,
+                                                      juce::int64 endSample,
+                                                      double deviceSampleRate,
+                                                      int crossfadeSamples);
+
+    static constexpr int numChannels = 2;
+};
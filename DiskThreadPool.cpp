@@ -0,0 +1,12 @@
+#include "DiskThreadPool.h"
+
+DiskThreadPool::DiskThreadPool()
+{
+    readAheadThread.startThread(juce::Thread::Priority::high);
+}
+
+DiskThreadPool::~DiskThreadPool()
+{
+    loaderPool.removeAllJobs(true, 4000);
+    readAheadThread.stopThread(4000);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Background threads for disk work, shared by every deck in the process.
+// Hold one through juce::SharedResourcePointer<DiskThreadPool>; the threads
+// start with the first user and stop when the last one goes away.
+class DiskThreadPool
+{
+public:
+    DiskThreadPool();
+    ~DiskThreadPool();
+
+    // services the BufferingAudioSource read-ahead of every deck
+    juce::TimeSliceThread& getReadAheadThread() { return readAheadThread; }
+
+    // runs one-off jobs such as opening and probing files
+    juce::ThreadPool& getLoaderPool() { return loaderPool; }
+
+private:
+    juce::TimeSliceThread readAheadThread{ "Audio Read-Ahead" };
+    juce::ThreadPool loaderPool{ 2 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiskThreadPool)
+};
@@ -0,0 +1,43 @@
+#include "Fft.h"
+
+Fft::Fft(int order)
+    : size(1 << order),
+      twiddles((size_t)size / 2),
+      bitReversed((size_t)size)
+{
+    for (int k = 0; k < size / 2; ++k)
+        twiddles[(size_t)k] = std::polar(1.0f, -juce::MathConstants<float>::twoPi * (float)k / (float)size);
+
+    for (int i = 0; i < size; ++i)
+    {
+        int reversed = 0;
+        for (int bit = 0; bit < order; ++bit)
+            reversed |= ((i >> bit) & 1) << (order - 1 - bit);
+
+        bitReversed[(size_t)i] = reversed;
+    }
+}
+
+void Fft::perform(std::complex<float>* data) const
+{
+    for (int i = 0; i < size; ++i)
+        if (i < bitReversed[(size_t)i])
+            std::swap(data[i], data[bitReversed[(size_t)i]]);
+
+    for (int length = 2; length <= size; length <<= 1)
+    {
+        const int half = length / 2;
+        const int step = size / length;
+
+        for (int start = 0; start < size; start += length)
+        {
+            for (int k = 0; k < half; ++k)
+            {
+                const auto u = data[start + k];
+                const auto v = data[start + k + half] * twiddles[(size_t)(k * step)];
+                data[start + k] = u + v;
+                data[start + k + half] = u - v;
+            }
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <JuceHeader.h>
+#include <complex>
+
+// In-place radix-2 complex FFT, with its twiddle and bit-reversal tables
+// built once. All the analysis here needs is magnitude spectra, and nothing
+// else in the app uses juce_dsp.
+class Fft
+{
+public:
+    explicit Fft(int order);
+
+    int getSize() const { return size; }
+    void perform(std::complex<float>* data) const;
+
+private:
+    int size;
+    std::vector<std::complex<float>> twiddles;
+    std::vector<int> bitReversed;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Fft)
+};
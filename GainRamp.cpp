@@ -0,0 +1,105 @@
+#include "GainRamp.h"
+
+namespace
+{
+    // data[i] *= (gain + gainStep * i) * (fade + fadeStep * i)
+    void multiplyByRamps(float* data, int numSamples, float gain, float gainStep, float fade, float fadeStep)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float index = (float)i;
+            data[i] *= (gain + gainStep * index) * (fade + fadeStep * index);
+        }
+    }
+
+    // dest[i] += source[i] * (gain + gainStep * i)
+    void addWithRamp(float* dest, const float* source, int numSamples, float gain, float gainStep)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += source[i] * (gain + gainStep * (float)i);
+    }
+}
+
+void GainRamp::reset(double sampleRate, double rampSeconds, float initialGain)
+{
+    rampLength = juce::jmax(1, juce::roundToInt(sampleRate * rampSeconds));
+    current = target = initialGain;
+    step = 0.0f;
+    remaining = 0;
+}
+
+void GainRamp::setTarget(float newTarget)
+{
+    if (newTarget == target)
+        return;
+
+    // a fresh ramp from wherever we are, so a slider dragged continuously
+    // is followed smoothly rather than in a staircase
+    target = newTarget;
+    remaining = juce::jmax(1, rampLength);
+    step = (target - current) / (float)remaining;
+}
+
+template <typename Segment>
+void GainRamp::advance(int numSamples, Segment&& segment)
+{
+    int offset = 0;
+
+    if (remaining > 0)
+    {
+        const int count = juce::jmin(numSamples, remaining);
+        segment(0, count, current, step);
+
+        remaining -= count;
+        current = remaining > 0 ? current + step * (float)count : target;
+        offset = count;
+    }
+
+    if (offset < numSamples)
+        segment(offset, numSamples - offset, current, 0.0f);
+}
+
+void GainRamp::apply(juce::AudioBuffer<float>& buffer, int startSample, int numSamples, int numChannels,
+                     float fadeStart, float fadeEnd)
+{
+    if (numSamples <= 0)
+        return;
+
+    const float fadeStep = (fadeEnd - fadeStart) / (float)numSamples;
+
+    advance(numSamples, [&](int offset, int count, float gain, float gainStep)
+    {
+        const float fade = fadeStart + fadeStep * (float)offset;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* data = buffer.getWritePointer(channel, startSample + offset);
+
+            if (gainStep != 0.0f || fadeStep != 0.0f)
+                multiplyByRamps(data, count, gain, gainStep, fade, fadeStep);
+            else if (gain * fade == 0.0f)
+                juce::FloatVectorOperations::clear(data, count);
+            else if (gain * fade != 1.0f)
+                juce::FloatVectorOperations::multiply(data, gain * fade, count);
+        }
+    });
+}
+
+void GainRamp::addFrom(juce::AudioBuffer<float>& dest, int destStartSample,
+                       const juce::AudioBuffer<float>& source, int sourceStartSample,
+                       int numSamples, int numChannels)
+{
+    advance(numSamples, [&](int offset, int count, float gain, float gainStep)
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* d = dest.getWritePointer(channel, destStartSample + offset);
+            const float* s = source.getReadPointer(channel, sourceStartSample + offset);
+
+            if (gainStep != 0.0f)
+                addWithRamp(d, s, count, gain, gainStep);
+            else if (gain != 0.0f)
+                juce::FloatVectorOperations::addWithMultiply(d, s, gain, count);
+        }
+    });
+}
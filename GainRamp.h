@@ -0,0 +1,49 @@
+#pragma once
+#include <JuceHeader.h>
+
+// A gain that glides to each new target in a straight line over a fixed
+// time instead of jumping, so volume, mute and crossfader moves don't
+// zipper. The ramp is applied in the same pass as whatever else the caller
+// does with the samples: multiplying in place, optionally by a fade as well,
+// or scaling one buffer into another while summing. The per-sample gain is
+// worked out from the sample's index rather than accumulated, so the loops
+// have no carried dependency and vectorise; a settled gain goes through
+// FloatVectorOperations.
+// Audio thread only, apart from reset().
+class GainRamp
+{
+public:
+    // short enough to feel immediate, long enough not to click
+    static constexpr double defaultRampSeconds = 0.02;
+
+    void reset(double sampleRate, double rampSeconds, float initialGain);
+
+    void setTarget(float newTarget);
+    float getTarget() const { return target; }
+    float getCurrent() const { return current; }
+    bool isRamping() const { return remaining > 0; }
+
+    // Multiplies the channels by the gain over the next numSamples samples,
+    // and by a linear fade from fadeStart to fadeEnd on top, then moves the
+    // ramp on by that many samples.
+    void apply(juce::AudioBuffer<float>& buffer, int startSample, int numSamples, int numChannels,
+               float fadeStart = 1.0f, float fadeEnd = 1.0f);
+
+    // Adds source times the gain into dest, then moves the ramp on.
+    void addFrom(juce::AudioBuffer<float>& dest, int destStartSample,
+                 const juce::AudioBuffer<float>& source, int sourceStartSample,
+                 int numSamples, int numChannels);
+
+private:
+    // Calls segment(offset, count, startGain, step) for the ramping part of
+    // the next numSamples samples and then for the settled part, and
+    // advances the ramp.
+    template <typename Segment>
+    void advance(int numSamples, Segment&& segment);
+
+    float current = 1.0f;
+    float target = 1.0f;
+    float step = 0.0f;
+    int remaining = 0;
+    int rampLength = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <JuceHeader.h>
+
+// The ITU-R BS.1770 K-weighting pre-filter, a high shelf followed by a
+// high-pass, that LUFS loudness is measured through. The coefficients are
+// worked out for any sample rate rather than taken from the 48kHz table
+// printed in the standard.
+class KWeighting
+{
+public:
+    static constexpr int maxChannels = 2;
+
+    explicit KWeighting(double sampleRate = 48000.0) { setSampleRate(sampleRate); }
+
+    // also clears the filter state
+    void setSampleRate(double sampleRate);
+    void reset();
+
+    // Filters one sample; channel must be below maxChannels.
+    double process(int channel, double x)
+    {
+        auto& s = state[(size_t)channel];
+        return highPass.process(shelf.process(x, s.shelf), s.highPass);
+    }
+
+    // the loudness in LUFS of a K-weighted mean square, summed over channels
+    static double toLufs(double meanSquare) { return -0.691 + 10.0 * std::log10(juce::jmax(meanSquare, 1.0e-20)); }
+
+private:
+    struct Biquad
+    {
+        double b0, b1, b2, a1, a2;
+
+        double process(double x, double* z) const
+        {
+            const double y = b0 * x + z[0];
+            z[0] = b1 * x - a1 * y + z[1];
+            z[1] = b2 * x - a2 * y;
+            return y;
+        }
+    };
+
+    struct ChannelState
+    {
+        double shelf[2] = {};
+        double highPass[2] = {};
+    };
+
+    Biquad shelf{}, highPass{};
+    std::array<ChannelState, maxChannels> state{};
+};
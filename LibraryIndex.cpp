@@ -0,0 +1,473 @@
+#include "LibraryIndex.h"
+#include "AppData.h"
+#include <set>
+
+namespace
+{
+    constexpr int indexMagic = 0x3142494c; // "LIB1"
+    constexpr int indexVersion = 5;
+}
+
+LibraryIndex::LibraryIndex()
+    : indexFile(getDefaultDirectory().getChildFile("library.idx"))
+{
+    formatManager.registerBasicFormats();
+    load();
+    pruneInBackground();
+}
+
+LibraryIndex::~LibraryIndex()
+{
+    stopTimer();
+    scanPool.removeAllJobs(true, 4000);
+    analysisPool.removeAllJobs(true, 4000);
+
+    if (dirty.load())
+        save();
+}
+
+juce::File LibraryIndex::getDefaultDirectory()
+{
+    return getAppDataDirectory();
+}
+
+bool LibraryIndex::isAudioFile(const juce::File& f)
+{
+    auto ext = f.getFileExtension().toLowerCase();
+    return ext == ".wav" || ext == ".mp3" || ext == ".aiff" || ext == ".flac" || ext == ".ogg" || ext == ".m4a";
+}
+
+int LibraryIndex::getNumTracks() const
+{
+    const juce::ScopedLock sl(lock);
+    return (int)tracks.size();
+}
+
+LibraryIndex::Track LibraryIndex::getTrack(int index) const
+{
+    const juce::ScopedLock sl(lock);
+    if (index >= 0 && index < (int)tracks.size())
+        return tracks[(size_t)index];
+    return {};
+}
+
+std::vector<LibraryIndex::Track> LibraryIndex::getSnapshot() const
+{
+    const juce::ScopedLock sl(lock);
+    return tracks;
+}
+
+int LibraryIndex::indexOf(const juce::File& file) const
+{
+    const juce::ScopedLock sl(lock);
+    auto found = indexByPath.find(file.getFullPathName());
+    return found != indexByPath.end() ? found->second : -1;
+}
+
+void LibraryIndex::addFiles(const juce::Array<juce::File>& files)
+{
+    juce::Array<juce::File> toProbe;
+
+    for (const auto& f : files)
+        if (isAudioFile(f) && needsProbing(f))
+            toProbe.add(f);
+
+    for (int start = 0; start < toProbe.size(); start += probeBatchSize)
+    {
+        juce::Array<juce::File> batch;
+        batch.addArray(toProbe, start, probeBatchSize);
+        probeInBackground(std::move(batch));
+    }
+}
+
+void LibraryIndex::scanDirectory(const juce::File& directory)
+{
+    ++pendingJobs;
+
+    scanPool.addJob([this, directory]
+    {
+        juce::Array<juce::File> batch;
+
+        for (const auto& entry : juce::RangedDirectoryIterator(directory, true, "*", juce::File::findFiles))
+        {
+            if (auto* job = juce::ThreadPoolJob::getCurrentThreadPoolJob())
+                if (job->shouldExit())
+                    break;
+
+            const auto f = entry.getFile();
+            if (!isAudioFile(f) || !needsProbing(f))
+                continue;
+
+            batch.add(f);
+
+            // hand batches to the other workers while we keep walking the tree
+            if (batch.size() == probeBatchSize)
+            {
+                probeInBackground(std::move(batch));
+                batch = {};
+            }
+        }
+
+        if (!batch.isEmpty())
+            probeInBackground(std::move(batch));
+
+        jobFinished();
+    });
+}
+
+bool LibraryIndex::needsProbing(const juce::File& file) const
+{
+    const juce::ScopedLock sl(lock);
+    auto found = indexByPath.find(file.getFullPathName());
+    if (found == indexByPath.end())
+        return true;
+
+    const auto& track = tracks[(size_t)found->second];
+    return track.fileSize != file.getSize()
+        || track.modificationTime != file.getLastModificationTime().toMilliseconds();
+}
+
+void LibraryIndex::probeInBackground(juce::Array<juce::File> files)
+{
+    ++pendingJobs;
+
+    scanPool.addJob([this, files]
+    {
+        std::vector<Track> probed;
+        probed.reserve((size_t)files.size());
+
+        for (const auto& f : files)
+        {
+            Track track;
+            if (probe(formatManager, f, track))
+                probed.push_back(std::move(track));
+        }
+
+        addProbedTracks(probed);
+        jobFinished();
+    });
+}
+
+bool LibraryIndex::probe(juce::AudioFormatManager& fm, const juce::File& file, Track& track)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(fm.createReaderFor(file));
+    if (reader == nullptr)
+        return false;
+
+    track.path = file.getFullPathName();
+    track.title = reader->metadataValues.getValue("title", "");
+    track.artist = reader->metadataValues.getValue("artist", "");
+    track.bpm = reader->metadataValues.getValue("bpm", "0").getDoubleValue();
+    track.sampleRate = reader->sampleRate;
+    track.numChannels = (int)reader->numChannels;
+    track.lengthInSeconds = reader->sampleRate > 0.0 ? (double)reader->lengthInSamples / reader->sampleRate : 0.0;
+    track.fileSize = file.getSize();
+    track.modificationTime = file.getLastModificationTime().toMilliseconds();
+
+    if (track.title.isEmpty())
+        track.title = file.getFileNameWithoutExtension();
+
+    return true;
+}
+
+void LibraryIndex::addProbedTracks(std::vector<Track>& probed)
+{
+    if (probed.empty())
+        return;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        for (const auto& track : probed)
+        {
+            auto found = indexByPath.find(track.path);
+            if (found != indexByPath.end())
+            {
+                tracks[(size_t)found->second] = track;
+            }
+            else
+            {
+                indexByPath.emplace(track.path, (int)tracks.size());
+                tracks.push_back(track);
+            }
+        }
+    }
+
+    // only once they're in, or a quick analysis would find nowhere to go
+    for (const auto& track : probed)
+        analyseInBackground(track);
+
+    dirty = true;
+    sendChangeMessage();
+}
+
+void LibraryIndex::pruneInBackground()
+{
+    ++pendingJobs;
+
+    scanPool.addJob([this]
+    {
+        // Files deleted or moved since the last run would otherwise sit in
+        // the playlist for good. Checking them is a stat per track, which a
+        // big library or a network share makes far too slow for start-up.
+        std::set<juce::String> missing;
+        std::vector<Track> toAnalyse;
+
+        for (const auto& track : getSnapshot())
+        {
+            if (auto* job = juce::ThreadPoolJob::getCurrentThreadPoolJob())
+                if (job->shouldExit())
+                    break;
+
+            if (!track.getFile().existsAsFile())
+                missing.insert(track.path);
+            else if (!track.analysed && !track.analysisFailed)
+                toAnalyse.push_back(track);
+        }
+
+        if (!missing.empty())
+        {
+            {
+                const juce::ScopedLock sl(lock);
+
+                tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                                            [&missing](const Track& track) { return missing.count(track.path) > 0; }),
+                             tracks.end());
+
+                indexByPath.clear();
+                for (size_t i = 0; i < tracks.size(); ++i)
+                    indexByPath.emplace(tracks[i].path, (int)i);
+            }
+
+            dirty = true;
+            sendChangeMessage();
+        }
+
+        for (const auto& track : toAnalyse)
+            analyseInBackground(track);
+
+        jobFinished();
+    });
+}
+
+void LibraryIndex::jobFinished()
+{
+    // the last job out writes the index
+    if (--pendingJobs == 0 && dirty.exchange(false))
+        save();
+}
+
+void LibraryIndex::analyseInBackground(const Track& track)
+{
+    ++pendingAnalyses;
+
+    analysisPool.addJob([this, track]
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(track.getFile()));
+        TrackAnalyser::Result result;
+
+        if (reader != nullptr && TrackAnalyser::analyse(*reader, result))
+            storeAnalysis(track, result);
+        else
+            storeAnalysisFailure(track);
+
+        analysisFinished();
+    });
+}
+
+void LibraryIndex::storeAnalysis(const Track& analysedTrack, const TrackAnalyser::Result& result)
+{
+    {
+        const juce::ScopedLock sl(lock);
+
+        auto found = indexByPath.find(analysedTrack.path);
+        if (found == indexByPath.end())
+            return;
+
+        // the file may have been re-probed while we were busy with it
+        auto& track = tracks[(size_t)found->second];
+        if (track.fileSize != analysedTrack.fileSize || track.modificationTime != analysedTrack.modificationTime)
+            return;
+
+        // a tempo from the tags is someone's considered opinion, so keep it
+        if (track.bpm <= 0.0)
+            track.bpm = result.bpm;
+
+        track.analysed = true;
+        track.firstBeat = result.firstBeatSeconds;
+        track.key = result.key;
+        track.loudness = result.loudness;
+        track.truePeak = result.truePeak;
+        track.leadingSilence = result.leadingSilence;
+        track.trailingSilence = result.trailingSilence;
+    }
+
+    dirty = true;
+    sendChangeMessage();
+}
+
+void LibraryIndex::setHotCue(const juce::File& file, int index, double seconds)
+{
+    if (!juce::isPositiveAndBelow(index, Track::numHotCues))
+        return;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        auto found = indexByPath.find(file.getFullPathName());
+        if (found == indexByPath.end())
+            return;
+
+        tracks[(size_t)found->second].hotCues[(size_t)index] = seconds >= 0.0 ? seconds : -1.0;
+    }
+
+    // cues are set by hand, so they're written out soon after, but only
+    // once the clicking has stopped rather than once per click
+    dirty = true;
+    startTimer(editSaveDelayMilliseconds);
+}
+
+void LibraryIndex::timerCallback()
+{
+    stopTimer();
+
+    // a scan in progress writes the index when it finishes
+    if (pendingJobs.load() == 0 && dirty.exchange(false))
+        save();
+}
+
+void LibraryIndex::storeAnalysisFailure(const Track& failedTrack)
+{
+    {
+        const juce::ScopedLock sl(lock);
+
+        auto found = indexByPath.find(failedTrack.path);
+        if (found == indexByPath.end())
+            return;
+
+        auto& track = tracks[(size_t)found->second];
+        if (track.fileSize != failedTrack.fileSize || track.modificationTime != failedTrack.modificationTime)
+            return;
+
+        // not worth trying again until the file changes and is re-probed
+        track.analysisFailed = true;
+    }
+
+    dirty = true;
+}
+
+void LibraryIndex::analysisFinished()
+{
+    // analysing a big library takes a while, so don't leave it all to the end
+    const bool lastOne = --pendingAnalyses == 0;
+    if ((lastOne || ++analysesSinceSave % analysesPerSave == 0) && pendingJobs.load() == 0 && dirty.exchange(false))
+        save();
+}
+
+void LibraryIndex::load()
+{
+    juce::MemoryBlock data;
+    if (!indexFile.loadFileAsData(data))
+        return;
+
+    juce::MemoryInputStream in(data, false);
+    if (in.readInt() != indexMagic)
+        return;
+
+    const int version = in.readInt();
+    if (version < 1 || version > indexVersion)
+        return;
+
+    const int count = in.readInt();
+    if (count <= 0)
+        return;
+
+    // a corrupt count can't ask for more tracks than the file could hold
+    constexpr int minBytesPerTrack = 39;
+    std::vector<Track> loaded;
+    loaded.reserve((size_t)juce::jmin((juce::int64)count, in.getNumBytesRemaining() / minBytesPerTrack));
+
+    for (int i = 0; i < count && !in.isExhausted(); ++i)
+    {
+        Track track;
+        track.path = in.readString();
+        track.title = in.readString();
+        track.artist = in.readString();
+        track.lengthInSeconds = in.readDouble();
+        if (version >= 2)
+            track.bpm = in.readDouble();
+        track.sampleRate = in.readDouble();
+        track.numChannels = in.readInt();
+        track.fileSize = in.readInt64();
+        track.modificationTime = in.readInt64();
+        if (version >= 3)
+        {
+            track.analysed = in.readBool();
+            track.firstBeat = in.readDouble();
+            track.key = in.readString();
+            track.loudness = in.readDouble();
+            track.truePeak = in.readDouble();
+            track.leadingSilence = in.readDouble();
+            track.trailingSilence = in.readDouble();
+        }
+        if (version >= 4)
+        {
+            for (auto& cue : track.hotCues)
+                cue = in.readDouble();
+        }
+        if (version >= 5)
+            track.analysisFailed = in.readBool();
+        loaded.push_back(std::move(track));
+    }
+
+    const juce::ScopedLock sl(lock);
+    tracks = std::move(loaded);
+    indexByPath.clear();
+    indexByPath.reserve(tracks.size());
+
+    for (size_t i = 0; i < tracks.size(); ++i)
+        indexByPath.emplace(tracks[i].path, (int)i);
+}
+
+void LibraryIndex::save() const
+{
+    juce::MemoryOutputStream out;
+
+    {
+        const juce::ScopedLock sl(lock);
+        out.writeInt(indexMagic);
+        out.writeInt(indexVersion);
+        out.writeInt((int)tracks.size());
+
+        for (const auto& track : tracks)
+        {
+            out.writeString(track.path);
+            out.writeString(track.title);
+            out.writeString(track.artist);
+            out.writeDouble(track.lengthInSeconds);
+            out.writeDouble(track.bpm);
+            out.writeDouble(track.sampleRate);
+            out.writeInt(track.numChannels);
+            out.writeInt64(track.fileSize);
+            out.writeInt64(track.modificationTime);
+            out.writeBool(track.analysed);
+            out.writeDouble(track.firstBeat);
+            out.writeString(track.key);
+            out.writeDouble(track.loudness);
+            out.writeDouble(track.truePeak);
+            out.writeDouble(track.leadingSilence);
+            out.writeDouble(track.trailingSilence);
+
+            for (auto cue : track.hotCues)
+                out.writeDouble(cue);
+
+            out.writeBool(track.analysisFailed);
+        }
+    }
+
+    indexFile.getParentDirectory().createDirectory();
+
+    juce::TemporaryFile temp(indexFile);
+    if (temp.getFile().replaceWithData(out.getData(), out.getDataSize()))
+        temp.overwriteTargetFileWithTemporary();
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TrackAnalyser.h"
+
+// The music library behind the playlist. Folders are scanned in parallel in
+// the background, each file's header is probed once for its duration, sample
+// rate and tags, and the result is kept in a compact on-disk index so the next
+// start-up only has to read that file. A background job then drops the
+// tracks whose files have gone, which is the one time indices move, and
+// listeners are told so they can rebuild. After that tracks are only ever
+// appended, so a track's index stays valid for the lifetime of the process.
+// Once probed, every track is also analysed on a low-priority pool for its
+// tempo, beat grid, key and loudness, and those results are kept in the index
+// too, so they're there the moment a track is loaded.
+// Shared through juce::SharedResourcePointer<LibraryIndex>; listeners are
+// notified on the message thread whenever tracks are added or dropped.
+class LibraryIndex : public juce::ChangeBroadcaster,
+    private juce::Timer
+{
+public:
+    struct Track
+    {
+        juce::String path;
+        juce::String title;
+        juce::String artist;
+        double lengthInSeconds = 0.0;
+        double bpm = 0.0;  // 0 when unknown
+        double sampleRate = 0.0;
+        int numChannels = 0;
+        juce::int64 fileSize = 0;
+        juce::int64 modificationTime = 0;
+
+        // filled in by TrackAnalyser once analysed is set
+        bool analysed = false;
+        double firstBeat = 0.0;        // seconds
+        juce::String key;
+        double loudness = -70.0;       // LUFS
+        double truePeak = -100.0;      // dBTP
+        double leadingSilence = 0.0;   // seconds
+        double trailingSilence = 0.0;  // seconds
+        bool analysisFailed = false;   // the file couldn't be read or decoded for analysis
+
+        // hot cue positions in seconds, -1 where there's none
+        static constexpr int numHotCues = 8;
+        std::array<double, numHotCues> hotCues{ -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0, -1.0 };
+
+        juce::File getFile() const { return juce::File(path); }
+    };
+
+    LibraryIndex();
+    ~LibraryIndex() override;
+
+    // probe these files in the background and add the audio ones
+    void addFiles(const juce::Array<juce::File>& files);
+
+    // recursively scan a folder in the background
+    void scanDirectory(const juce::File& directory);
+
+    int getNumTracks() const;
+    Track getTrack(int index) const;
+    std::vector<Track> getSnapshot() const;
+    int indexOf(const juce::File& file) const;
+    bool isScanning() const { return pendingJobs.load() > 0; }
+    bool isAnalysing() const { return pendingAnalyses.load() > 0; }
+
+    // Stores a hot cue for the track at file, or clears it if seconds is
+    // negative. Ignored for files that aren't in the library.
+    void setHotCue(const juce::File& file, int index, double seconds);
+
+    static bool isAudioFile(const juce::File& f);
+    static juce::File getDefaultDirectory();
+
+private:
+    void pruneInBackground();
+    void probeInBackground(juce::Array<juce::File> files);
+    bool needsProbing(const juce::File& file) const;
+    static bool probe(juce::AudioFormatManager& formatManager, const juce::File& file, Track& track);
+    void addProbedTracks(std::vector<Track>& probed);
+    void jobFinished();
+    void analyseInBackground(const Track& track);
+    void storeAnalysis(const Track& track, const TrackAnalyser::Result& result);
+    void storeAnalysisFailure(const Track& track);
+    void analysisFinished();
+    void timerCallback() override;
+
+    void load();
+    void save() const;
+
+    juce::File indexFile;
+    juce::AudioFormatManager formatManager;
+
+    mutable juce::CriticalSection lock;
+    std::vector<Track> tracks;
+    std::unordered_map<juce::String, int> indexByPath;
+
+    std::atomic<int> pendingJobs{ 0 };
+    std::atomic<bool> dirty{ false };
+    juce::ThreadPool scanPool{ juce::jmax(1, juce::SystemStats::getNumCpus() - 1) };
+
+    std::atomic<int> pendingAnalyses{ 0 };
+    std::atomic<int> analysesSinceSave{ 0 };
+    juce::ThreadPool analysisPool{ juce::jmax(1, juce::SystemStats::getNumCpus() - 1), 0, juce::Thread::Priority::low };
+
+    static constexpr int probeBatchSize = 128;
+    static constexpr int analysesPerSave = 32;
+    static constexpr int editSaveDelayMilliseconds = 2000;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LibraryIndex)
+};
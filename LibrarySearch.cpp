@@ -0,0 +1,199 @@
+#include "LibrarySearch.h"
+
+std::vector<std::string> LibrarySearch::tokenise(const juce::String& text)
+{
+    std::vector<std::string> words;
+    auto lower = text.toLowerCase();
+    auto p = lower.getCharPointer();
+
+    while (!p.isEmpty())
+    {
+        while (!p.isEmpty() && !p.isLetterOrDigit())
+            ++p;
+
+        auto start = p;
+
+        while (!p.isEmpty() && p.isLetterOrDigit())
+            ++p;
+
+        if (p != start)
+            words.push_back(juce::String(start, p).toStdString());
+    }
+
+    return words;
+}
+
+std::shared_ptr<const LibrarySearch> LibrarySearch::build(const std::vector<LibraryIndex::Track>& tracks)
+{
+    std::shared_ptr<LibrarySearch> index(new LibrarySearch());
+    index->numTracks = (int)tracks.size();
+
+    // (term, track) pairs, sorted so equal terms end up next to each other
+    std::vector<std::pair<std::string, int>> pairs;
+    pairs.reserve(tracks.size() * 6);
+
+    for (int i = 0; i < (int)tracks.size(); ++i)
+    {
+        const auto& t = tracks[(size_t)i];
+        auto words = tokenise(t.title + " " + t.artist + " " + t.getFile().getFileNameWithoutExtension());
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+
+        for (auto& w : words)
+            pairs.emplace_back(std::move(w), i);
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+
+    index->postings.reserve(pairs.size());
+    for (size_t i = 0; i < pairs.size(); ++i)
+    {
+        if (i == 0 || pairs[i].first != pairs[i - 1].first)
+        {
+            index->terms.push_back(pairs[i].first);
+            index->postingsStart.push_back((int)index->postings.size());
+        }
+
+        index->postings.push_back(pairs[i].second);
+    }
+    index->postingsStart.push_back((int)index->postings.size());
+
+    // one precomputed permutation per column
+    std::vector<std::string> titles, artists, paths;
+    titles.reserve(tracks.size());
+    artists.reserve(tracks.size());
+    paths.reserve(tracks.size());
+
+    for (const auto& t : tracks)
+    {
+        titles.push_back(t.title.toLowerCase().toStdString());
+        artists.push_back(t.artist.toLowerCase().toStdString());
+        paths.push_back(t.path.toLowerCase().toStdString());
+    }
+
+    auto makeOrder = [&tracks](auto less)
+    {
+        std::vector<int> order(tracks.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), less);
+        return order;
+    };
+
+    index->byTitle = makeOrder([&titles](int a, int b) { return titles[(size_t)a] < titles[(size_t)b]; });
+    index->byArtist = makeOrder([&artists](int a, int b) { return artists[(size_t)a] < artists[(size_t)b]; });
+    index->byPath = makeOrder([&paths](int a, int b) { return paths[(size_t)a] < paths[(size_t)b]; });
+    index->byDuration = makeOrder([&tracks](int a, int b) { return tracks[(size_t)a].lengthInSeconds < tracks[(size_t)b].lengthInSeconds; });
+    index->byBpm = makeOrder([&tracks](int a, int b) { return tracks[(size_t)a].bpm < tracks[(size_t)b].bpm; });
+
+    auto makeRank = [](const std::vector<int>& order)
+    {
+        std::vector<int> rank(order.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            rank[(size_t)order[i]] = (int)i;
+        return rank;
+    };
+
+    index->titleRank = makeRank(index->byTitle);
+    index->artistRank = makeRank(index->byArtist);
+    index->pathRank = makeRank(index->byPath);
+    index->durationRank = makeRank(index->byDuration);
+    index->bpmRank = makeRank(index->byBpm);
+
+    return index;
+}
+
+const std::vector<int>& LibrarySearch::getOrder(Column column) const
+{
+    switch (column)
+    {
+    case Column::artist:   return byArtist;
+    case Column::duration: return byDuration;
+    case Column::bpm:      return byBpm;
+    case Column::path:     return byPath;
+    case Column::title:
+    default:               return byTitle;
+    }
+}
+
+const std::vector<int>& LibrarySearch::getRank(Column column) const
+{
+    switch (column)
+    {
+    case Column::artist:   return artistRank;
+    case Column::duration: return durationRank;
+    case Column::bpm:      return bpmRank;
+    case Column::path:     return pathRank;
+    case Column::title:
+    default:               return titleRank;
+    }
+}
+
+std::vector<int> LibrarySearch::query(const juce::String& text, Column sortColumn, bool ascending) const
+{
+    const auto& order = getOrder(sortColumn);
+    const auto words = tokenise(text);
+
+    std::vector<int> result;
+
+    if (words.empty())
+    {
+        result = order;
+    }
+    else
+    {
+        // each word's tracks: the postings of every term it's a prefix of,
+        // sorted by track index
+        std::vector<std::vector<int>> candidates;
+        candidates.reserve(words.size());
+
+        for (const auto& prefix : words)
+        {
+            std::vector<int> tracksForWord;
+            int numTerms = 0;
+            auto first = std::lower_bound(terms.begin(), terms.end(), prefix);
+
+            for (auto term = first; term != terms.end() && term->compare(0, prefix.size(), prefix) == 0; ++term, ++numTerms)
+            {
+                const auto t = (size_t)(term - terms.begin());
+                tracksForWord.insert(tracksForWord.end(), postings.begin() + postingsStart[t],
+                                     postings.begin() + postingsStart[t + 1]);
+            }
+
+            // one term's postings are already sorted and unique
+            if (numTerms > 1)
+            {
+                std::sort(tracksForWord.begin(), tracksForWord.end());
+                tracksForWord.erase(std::unique(tracksForWord.begin(), tracksForWord.end()), tracksForWord.end());
+            }
+
+            if (tracksForWord.empty())
+                return result;
+
+            candidates.push_back(std::move(tracksForWord));
+        }
+
+        // intersect starting from the shortest list, so no step handles
+        // more tracks than the rarest word has
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const std::vector<int>& a, const std::vector<int>& b) { return a.size() < b.size(); });
+
+        result = std::move(candidates.front());
+
+        for (size_t w = 1; w < candidates.size() && !result.empty(); ++w)
+        {
+            const auto& other = candidates[w];
+            result.erase(std::remove_if(result.begin(), result.end(),
+                                        [&other](int t) { return !std::binary_search(other.begin(), other.end(), t); }),
+                         result.end());
+        }
+
+        const auto& rank = getRank(sortColumn);
+        std::sort(result.begin(), result.end(),
+                  [&rank](int a, int b) { return rank[(size_t)a] < rank[(size_t)b]; });
+    }
+
+    if (!ascending)
+        std::reverse(result.begin(), result.end());
+
+    return result;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <JuceHeader.h>
+#include "LibraryIndex.h"
+
+// Immutable search and sort index over a snapshot of the library. Every word
+// of every title, artist and file name goes into a sorted term list with
+// posting lists, so a query is a binary search per typed word, a walk over
+// the matching postings and an intersection starting from the shortest, and
+// costs as much as the matches rather than the library. Each column's sort
+// order, and every track's rank in it, is precomputed.
+// Build it on a background thread and share it read-only.
+class LibrarySearch
+{
+public:
+    enum class Column
+    {
+        title = 1,
+        artist,
+        duration,
+        bpm,
+        path
+    };
+
+    static std::shared_ptr<const LibrarySearch> build(const std::vector<LibraryIndex::Track>& tracks);
+
+    // Indices of the tracks whose words start with every word of the query,
+    // in the requested order. An empty query returns every track.
+    std::vector<int> query(const juce::String& text, Column sortColumn, bool ascending) const;
+
+    int getNumTracks() const { return numTracks; }
+
+    // lower-cased words of the text, split on anything that isn't a letter or digit
+    static std::vector<std::string> tokenise(const juce::String& text);
+
+private:
+    LibrarySearch() = default;
+
+    const std::vector<int>& getOrder(Column column) const;
+    const std::vector<int>& getRank(Column column) const;
+
+    int numTracks = 0;
+
+    // terms are sorted and unique; term i's tracks are
+    // postings[postingsStart[i] .. postingsStart[i + 1])
+    std::vector<std::string> terms;
+    std::vector<int> postingsStart;
+    std::vector<int> postings;
+
+    std::vector<int> byTitle, byArtist, byDuration, byBpm, byPath;
+
+    // a track's position in each of the orders above
+    std::vector<int> titleRank, artistRank, durationRank, bpmRank, pathRank;
+};
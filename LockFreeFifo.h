@@ -0,0 +1,48 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Fixed-capacity single-producer / single-consumer queue built on
+// juce::AbstractFifo. push() and pop() never lock or allocate, so one end can
+// live on the message thread and the other on the audio thread. pop() moves
+// items out, so a slot doesn't keep shared objects alive once consumed.
+template <typename ItemType, int capacity>
+class LockFreeFifo
+{
+public:
+    bool push(const ItemType& item)
+    {
+        const auto scope = fifo.write(1);
+
+        if (scope.blockSize1 > 0)
+            items[(size_t)scope.startIndex1] = item;
+        else if (scope.blockSize2 > 0)
+            items[(size_t)scope.startIndex2] = item;
+        else
+            return false;
+
+        return true;
+    }
+
+    bool pop(ItemType& item)
+    {
+        const auto scope = fifo.read(1);
+
+        if (scope.blockSize1 > 0)
+            item = std::move(items[(size_t)scope.startIndex1]);
+        else if (scope.blockSize2 > 0)
+            item = std::move(items[(size_t)scope.startIndex2]);
+        else
+            return false;
+
+        return true;
+    }
+
+    int getNumReady() const { return fifo.getNumReady(); }
+    int getFreeSpace() const { return fifo.getFreeSpace(); }
+
+private:
+    juce::AbstractFifo fifo{ capacity };
+    std::array<ItemType, (size_t)capacity> items{};
+
+    JUCE_DECLARE_NON_COPYABLE(LockFreeFifo)
+};
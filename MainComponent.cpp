@@ -1,23 +1,59 @@
 ﻿#include "MainComponent.h"
 
 MainComponent::MainComponent()
-    : playerA(formatManager),
-    playerB(formatManager)
 {
     
     formatManager.registerBasicFormats();
 
     sharedPlaylist = std::make_unique<PlayerGUI::PlaylistComponent>();
 
-    deckA = std::make_unique<PlayerGUI>(playerA, sharedPlaylist.get());
-    deckB = std::make_unique<PlayerGUI>(playerB, sharedPlaylist.get());
+    addAndMakeVisible(deckViewport);
+    deckViewport.setViewedComponent(&deckGrid, false);
+    deckViewport.setScrollBarsShown(true, false);
 
-    addAndMakeVisible(*deckA);
-    addAndMakeVisible(*deckB);
+    for (int i = 0; i < numInitialDecks; ++i)
+        addDeck();
 
     addAndMakeVisible(crossfadeSlider);
     crossfadeSlider.setRange(0.0, 1.0, 0.001);
-    crossfadeSlider.setValue(0.5);
+    crossfadeSlider.onValueChange = [this] { updateCrossfade(); };
+    crossfadeSlider.setValue(0.5, juce::sendNotificationSync);
+
+    addAndMakeVisible(crossfadeLawBox);
+    crossfadeLawBox.addItem("Linear", 1 + (int)Crossfader::Law::linear);
+    crossfadeLawBox.addItem("Equal power", 1 + (int)Crossfader::Law::equalPower);
+    crossfadeLawBox.addItem("No dip", 1 + (int)Crossfader::Law::noDip);
+    crossfadeLawBox.addItem("Custom...", 1 + (int)Crossfader::Law::custom);
+    crossfadeLawBox.setSelectedId(1 + (int)crossfader.getLaw(), juce::dontSendNotification);
+    crossfadeLawBox.onChange = [this]
+    {
+        const auto law = (Crossfader::Law)(crossfadeLawBox.getSelectedId() - 1);
+        if (law == Crossfader::Law::custom)
+            editCustomCrossfadeCurve();
+        else
+            setCrossfadeLaw(law);
+    };
+
+    addAndMakeVisible(addDeckButton);
+    addDeckButton.onClick = [this] { addDeck(); };
+
+    addAndMakeVisible(removeDeckButton);
+    removeDeckButton.onClick = [this] { removeDeck(); };
+    removeDeckButton.setEnabled(false);
+
+    addAndMakeVisible(masterDisplay);
+
+    addAndMakeVisible(recordButton);
+    recordButton.onClick = [this] { toggleRecording(); };
+
+    addChildComponent(profilerOverlay);
+    addAndMakeVisible(profilerButton);
+    profilerButton.setClickingTogglesState(true);
+    profilerButton.onClick = [this]
+    {
+        profilerOverlay.setVisible(profilerButton.getToggleState());
+        profilerOverlay.toFront(false);
+    };
 
  
     addAndMakeVisible(*sharedPlaylist);
@@ -29,54 +65,177 @@ MainComponent::MainComponent()
 MainComponent::~MainComponent()
 {
     shutdownAudio();
+    recorder.stop();
 }
 
-void MainComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+void MainComponent::addDeck()
 {
-    playerA.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    playerB.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    if (players.size() >= DeckMixer::maxDecks)
+        return;
 
-    mixerSource.addInputSource(&playerA.getAudioSourceAdapter(), false);
-    mixerSource.addInputSource(&playerB.getAudioSourceAdapter(), false);
+    auto* player = players.add(new PlayerAudio(formatManager));
+    auto* deck = decks.add(new PlayerGUI(*player, sharedPlaylist.get()));
+    deckGrid.addAndMakeVisible(deck);
 
-    mixerSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    mixer.addDeck(player);
+    addDeckButton.setEnabled(players.size() < DeckMixer::maxDecks);
+    removeDeckButton.setEnabled(players.size() > numInitialDecks);
+    resized();
 }
 
-void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+void MainComponent::removeDeck()
 {
-   
-    bufferToFill.clearActiveBufferRegion();
+    // the first two are the crossfader's
+    if (players.size() <= numInitialDecks)
+        return;
 
-    juce::AudioBuffer<float> tempA(bufferToFill.buffer->getNumChannels(), bufferToFill.numSamples);
-    juce::AudioBuffer<float> tempB(bufferToFill.buffer->getNumChannels(), bufferToFill.numSamples);
+    // returns once the callback has let go of the player, so it can be deleted
+    auto* player = players.getLast();
+    mixer.removeDeck(player);
 
-    juce::AudioSourceChannelInfo infoA(&tempA, 0, bufferToFill.numSamples);
-    juce::AudioSourceChannelInfo infoB(&tempB, 0, bufferToFill.numSamples);
+    decks.removeLast();
+    players.removeLast();
 
-    
-    playerA.getNextAudioBlock(infoA);
-    playerB.getNextAudioBlock(infoB);
+    addDeckButton.setEnabled(players.size() < DeckMixer::maxDecks);
+    removeDeckButton.setEnabled(players.size() > numInitialDecks);
+    resized();
+}
 
-    float mixValue = (float)crossfadeSlider.getValue(); 
+void MainComponent::setCrossfadeLaw(Crossfader::Law law)
+{
+    crossfader.setLaw(law);
+    updateCrossfade();
+}
 
-    for (int channel = 0; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+void MainComponent::editCustomCrossfadeCurve()
+{
+    juce::String current;
+    for (auto gain : crossfader.getCustomCurve())
+        current << (current.isEmpty() ? "" : ", ") << juce::String(gain, 2);
+
+    auto* window = new juce::AlertWindow("Custom crossfade",
+                                         "A deck's gain, from 0 to 1, at evenly spaced fader positions from its own end "
+                                         "to the far end, separated by commas. The other deck mirrors it.",
+                                         juce::MessageBoxIconType::NoIcon);
+    window->addTextEditor("curve", current.isNotEmpty() ? current : "1, 1, 0.9, 0.6, 0");
+    window->addButton("OK", 1, juce::KeyPress(juce::KeyPress::returnKey));
+    window->addButton("Cancel", 0, juce::KeyPress(juce::KeyPress::escapeKey));
+
+    juce::Component::SafePointer<MainComponent> safeThis(this);
+    window->enterModalState(true, juce::ModalCallbackFunction::create([safeThis, window](int result)
     {
-        float* out = bufferToFill.buffer->getWritePointer(channel, bufferToFill.startSample);
-        const float* inA = tempA.getReadPointer(channel);
-        const float* inB = tempB.getReadPointer(channel);
+        if (safeThis == nullptr)
+            return;
 
-        for (int i = 0; i < bufferToFill.numSamples; ++i)
+        if (result != 0)
         {
-            out[i] = inA[i] * (1.0f - mixValue) + inB[i] * mixValue;
+            auto tokens = juce::StringArray::fromTokens(window->getTextEditorContents("curve"), ",; ", {});
+            tokens.removeEmptyStrings();
+
+            std::vector<float> gains;
+            for (const auto& token : tokens)
+                gains.push_back(juce::jlimit(0.0f, 1.0f, token.getFloatValue()));
+
+            safeThis->crossfader.setCustomCurve(std::move(gains));
         }
+
+        // cancelling, or a curve too short to use, leaves the previous law
+        safeThis->crossfadeLawBox.setSelectedId(1 + (int)safeThis->crossfader.getLaw(), juce::dontSendNotification);
+        safeThis->updateCrossfade();
+    }), true);
+}
+
+void MainComponent::updateCrossfade()
+{
+    float gainA = 1.0f, gainB = 1.0f;
+    crossfader.getGains((float)crossfadeSlider.getValue(), gainA, gainB);
+    mixer.setDeckGain(0, gainA);
+    mixer.setDeckGain(1, gainB);
+}
+
+void MainComponent::toggleRecording()
+{
+    if (recorder.isRecording())
+    {
+        stopRecording();
+        return;
+    }
+
+    const auto name = "Mix " + juce::Time::getCurrentTime().formatted("%Y-%m-%d %H-%M-%S") + ".wav";
+    const auto defaultFile = juce::File::getSpecialLocation(juce::File::userMusicDirectory).getChildFile(name);
+
+    recordChooser = std::make_unique<juce::FileChooser>("Record the mix to...", defaultFile, "*.wav;*.flac");
+    recordChooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                                   | juce::FileBrowserComponent::warnAboutOverwriting,
+        [this](const juce::FileChooser& fc)
+        {
+            const auto file = fc.getResult();
+            if (file != juce::File())
+                startRecording(file);
+        });
+}
+
+void MainComponent::startRecording(const juce::File& file)
+{
+    juce::String error;
+    if (!recorder.start(file, deviceSampleRate, 24, error))
+    {
+        juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Recording", error);
+        return;
     }
+
+    recordButton.setColour(juce::TextButton::buttonColourId, juce::Colours::darkred);
+    startTimerHz(4);
+    timerCallback();
+}
+
+void MainComponent::stopRecording()
+{
+    stopTimer();
+    recorder.stop();
+    recordButton.setButtonText("Record");
+    recordButton.removeColour(juce::TextButton::buttonColourId);
+
+    juce::String problem;
+    if (recorder.hasWriteFailed())
+        problem = "Writing to the disk failed part way through; the recording stops there.";
+    else if (recorder.getDroppedSamples() > 0)
+        problem = "The disk fell behind and " + juce::String(recorder.getDroppedSamples() / juce::jmax(1.0, deviceSampleRate), 2)
+                  + "s of audio couldn't be recorded.";
+
+    if (problem.isNotEmpty())
+        juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Recording",
+                                               problem + "\n" + recorder.getFile().getFullPathName());
+}
+
+void MainComponent::timerCallback()
+{
+    const int seconds = (int)recorder.getRecordedSeconds();
+    recordButton.setButtonText(juce::String::formatted("Stop %d:%02d:%02d", seconds / 3600, (seconds / 60) % 60, seconds % 60));
+
+    // the disk is falling behind
+    if (recorder.getDroppedSamples() > 0 || recorder.hasWriteFailed())
+        recordButton.setColour(juce::TextButton::buttonColourId, juce::Colours::orange);
+}
+
+void MainComponent::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    deviceSampleRate = sampleRate;
+    masterTap.prepare(sampleRate);
+    mixer.prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void MainComponent::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    AudioProfiler::ScopedCallback profile(bufferToFill.numSamples, deviceSampleRate);
+    mixer.getNextAudioBlock(bufferToFill);
+    masterTap.push(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+    recorder.push(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
 }
 
 void MainComponent::releaseResources()
 {
-    mixerSource.releaseResources();
-    playerA.releaseResources();
-    playerB.releaseResources();
+    mixer.releaseResources();
 }
 
 void MainComponent::paint(juce::Graphics& g)
@@ -86,13 +245,36 @@ void MainComponent::paint(juce::Graphics& g)
 
 void MainComponent::resized()
 {
+    if (sharedPlaylist == nullptr)
+        return;
+
     auto r = getLocalBounds().reduced(8);
     auto left = r.removeFromLeft(260);
     sharedPlaylist->setBounds(left);
 
-    auto top = r.removeFromTop(getHeight() / 2 - 10);
-    deckA->setBounds(top.removeFromLeft(r.getWidth() / 2 - 8));
-    deckB->setBounds(r); 
+    auto bottom = r.removeFromBottom(40);
+    masterDisplay.setBounds(r.removeFromBottom(64).reduced(4));
+    addDeckButton.setBounds(bottom.removeFromRight(100).reduced(0, 8));
+    removeDeckButton.setBounds(bottom.removeFromRight(110).reduced(4, 8));
+    profilerButton.setBounds(bottom.removeFromLeft(90).reduced(0, 8));
+    recordButton.setBounds(bottom.removeFromLeft(110).reduced(4, 8));
+    profilerOverlay.setBounds(r.withSizeKeepingCentre(juce::jmin(r.getWidth(), 520), 205));
+    crossfadeSlider.setBounds(bottom.withSizeKeepingCentre(300, 24));
+    crossfadeLawBox.setBounds(crossfadeSlider.getBounds().withX(crossfadeSlider.getRight() + 8).withWidth(110));
+
+    // two decks side by side per row, scrolling rather than squashing them
+    // once there are more rows than fit
+    const int numRows = juce::jmax(1, (decks.size() + 1) / 2);
+    const int rowHeight = juce::jmax(minDeckHeight, r.getHeight() / numRows);
+    const bool scrolling = rowHeight * numRows > r.getHeight();
 
-    crossfadeSlider.setBounds(getWidth() / 2 - 150, getHeight() - 50, 300, 24);
+    deckViewport.setBounds(r);
+    deckGrid.setSize(r.getWidth() - (scrolling ? deckViewport.getScrollBarThickness() : 0), rowHeight * numRows);
+
+    for (int i = 0; i < decks.size(); ++i)
+    {
+        auto row = deckGrid.getLocalBounds().withY(i / 2 * rowHeight).withHeight(rowHeight);
+        auto cell = (i % 2 == 0) ? row.removeFromLeft(row.getWidth() / 2) : row.withTrimmedLeft(row.getWidth() / 2);
+        decks[i]->setBounds(cell.reduced(4));
+    }
 }
\ No newline at end of file
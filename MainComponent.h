@@ -3,10 +3,16 @@
 #include <JuceHeader.h>
 #include "PlayerGUI.h"
 #include "PlayerAudio.h"
+#include "DeckMixer.h"
+#include "Crossfader.h"
+#include "TapDisplay.h"
+#include "ProfilerOverlay.h"
+#include "MasterRecorder.h"
 
 
 class MainComponent : public juce::AudioAppComponent,
-    public juce::AudioSource
+    public juce::AudioSource,
+    private juce::Timer
 {
 public:
     MainComponent();
@@ -21,21 +27,63 @@ public:
     void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
     void releaseResources() override;
 
+    // Adds a player and its deck UI, and hands the player to the mixer.
+    void addDeck();
+
+    // Removes the most recently added deck, down to the initial two.
+    void removeDeck();
+
+    void setCrossfadeLaw(Crossfader::Law law);
+
 private:
     juce::AudioFormatManager formatManager;
 
     std::unique_ptr<PlayerGUI::PlaylistComponent> sharedPlaylist;
 
-    PlayerAudio playerA;
-    PlayerAudio playerB;
+    // the decks sit in a grid that scrolls once they no longer fit
+    juce::Component deckGrid;
+    juce::Viewport deckViewport;
 
-    
-    std::unique_ptr<PlayerGUI> deckA;
-    std::unique_ptr<PlayerGUI> deckB;
+    juce::OwnedArray<PlayerAudio> players;
+    juce::OwnedArray<PlayerGUI> decks;
 
-    
-    juce::MixerAudioSource mixerSource;
+    // renders the players in parallel and sums them; the crossfader sets the
+    // gains of the first two, any further decks play at unity
+    DeckMixer mixer;
+    Crossfader crossfader;
     juce::Slider crossfadeSlider;
+    juce::ComboBox crossfadeLawBox;
+
+    // what goes to the device, after the mix
+    AudioTap masterTap;
+    TapDisplay masterDisplay{ masterTap };
+
+    // records what goes to the device; the button shows the elapsed time
+    MasterRecorder recorder;
+    juce::TextButton recordButton{ "Record" };
+    std::unique_ptr<juce::FileChooser> recordChooser;
+    juce::TextButton addDeckButton{ "Add Deck" };
+    juce::TextButton removeDeckButton{ "Remove Deck" };
+
+    void updateCrossfade();
+    void editCustomCrossfadeCurve();
+    void toggleRecording();
+    void startRecording(const juce::File& file);
+    void stopRecording();
+    void timerCallback() override;
+
+    // shows the tooltips of every component in the window
+    juce::TooltipWindow tooltipWindow{ this };
+
+    // debug timing overlay; profiling only runs while it's showing
+    ProfilerOverlay profilerOverlay;
+    juce::TextButton profilerButton{ "Profiler" };
+    double deviceSampleRate = 0.0;
+
+    static constexpr int numInitialDecks = 2;
+
+    // a deck's controls plus its waveform, below which rows start scrolling
+    static constexpr int minDeckHeight = 460;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
\ No newline at end of file
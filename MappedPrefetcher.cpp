@@ -0,0 +1,82 @@
+#include "MappedPrefetcher.h"
+
+namespace
+{
+    // assume the smallest common page size; touching twice per larger page
+    // costs next to nothing once it's resident
+    constexpr int pageSize = 4096;
+
+    // about a second per slice at CD rates, so one deck's catch-up after a
+    // seek doesn't hold up the other decks' read-ahead for long
+    constexpr juce::int64 samplesPerSlice = 1 << 16;
+}
+
+MappedPrefetcher::MappedPrefetcher(juce::MemoryMappedAudioFormatReader& r,
+                                   juce::TimeSliceThread& t,
+                                   juce::int64 window)
+    : reader(r),
+      thread(t),
+      windowSamples(juce::jmax((juce::int64)0, window)),
+      lengthInSamples(r.getMappedSection().getEnd())
+{
+    const int bytesPerFrame = (int)(r.numChannels * (unsigned int)r.bitsPerSample / 8);
+    samplesPerPage = juce::jmax(1, pageSize / juce::jmax(1, bytesPerFrame));
+
+    thread.addTimeSliceClient(this);
+}
+
+MappedPrefetcher::~MappedPrefetcher()
+{
+    // waits for a slice that's running to finish
+    thread.removeTimeSliceClient(this);
+}
+
+void MappedPrefetcher::prefetchNow(juce::int64 startSample, juce::int64 numSamples)
+{
+    touch(startSample, startSample + numSamples);
+}
+
+void MappedPrefetcher::prefetchAround(juce::int64 sample)
+{
+    seekTarget.store(juce::jmax((juce::int64)0, sample));
+    thread.moveToFrontOfQueue(this);
+}
+
+int MappedPrefetcher::useTimeSlice()
+{
+    const auto target = seekTarget.exchange(-1);
+    if (target >= 0)
+    {
+        touch(target, target + samplesPerSlice);
+        return 0;
+    }
+
+    // start over wherever the playhead has jumped to; pages we touched
+    // before are probably still resident, so that's cheap
+    const auto position = playhead.load(std::memory_order_relaxed);
+    if (position < windowStart || position > windowEnd)
+        windowEnd = position;
+
+    windowStart = position;
+    const auto wanted = juce::jmin(position + windowSamples, lengthInSamples);
+
+    if (windowEnd >= wanted)
+        return 20;
+
+    const auto end = juce::jmin(wanted, windowEnd + samplesPerSlice);
+    touch(windowEnd, end);
+    windowEnd = end;
+    return 0;
+}
+
+void MappedPrefetcher::touch(juce::int64 startSample, juce::int64 endSample)
+{
+    startSample = juce::jmax((juce::int64)0, startSample);
+    endSample = juce::jmin(endSample, lengthInSamples);
+
+    for (auto sample = startSample; sample < endSample; sample += samplesPerPage)
+        reader.touchSample(sample);
+
+    if (endSample > startSample)
+        reader.touchSample(endSample - 1);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Keeps the pages of a memory-mapped file resident ahead of the playhead, so
+// the audio thread reads PCM straight out of the page cache instead of
+// faulting on the disk. The work runs on a shared TimeSliceThread; the audio
+// thread only publishes where it is, and seek targets are touched first.
+class MappedPrefetcher : private juce::TimeSliceClient
+{
+public:
+    // windowSamples is how far ahead of the playhead to keep resident
+    MappedPrefetcher(juce::MemoryMappedAudioFormatReader& reader,
+                     juce::TimeSliceThread& thread,
+                     juce::int64 windowSamples);
+    ~MappedPrefetcher() override;
+
+    // Touches [startSample, startSample + numSamples) before returning. Blocks
+    // on the disk, so only call it from a background thread.
+    void prefetchNow(juce::int64 startSample, juce::int64 numSamples);
+
+    // Called by the audio thread with the transport's read position.
+    void setPlayhead(juce::int64 sample) noexcept { playhead.store(sample, std::memory_order_relaxed); }
+
+    // Queues the region after a position we're about to jump to, ahead of
+    // the playhead window. Safe to call from any thread but the audio thread.
+    void prefetchAround(juce::int64 sample);
+
+private:
+    int useTimeSlice() override;
+    void touch(juce::int64 startSample, juce::int64 endSample);
+
+    juce::MemoryMappedAudioFormatReader& reader;
+    juce::TimeSliceThread& thread;
+    const juce::int64 windowSamples;
+    const juce::int64 lengthInSamples;
+    int samplesPerPage = 1;
+
+    std::atomic<juce::int64> playhead{ 0 };
+    std::atomic<juce::int64> seekTarget{ -1 };
+
+    // the part of the window already touched; only used on the thread
+    juce::int64 windowStart = 0;
+    juce::int64 windowEnd = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MappedPrefetcher)
+};
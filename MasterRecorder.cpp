@@ -0,0 +1,160 @@
+#include "MasterRecorder.h"
+
+MasterRecorder::MasterRecorder()
+    : juce::Thread("Master Recorder")
+{
+}
+
+MasterRecorder::~MasterRecorder()
+{
+    stop();
+}
+
+bool MasterRecorder::start(const juce::File& file, double sampleRate, int bitsPerSample, juce::String& error)
+{
+    stop();
+
+    if (sampleRate <= 0.0)
+    {
+        error = "The audio device isn't running";
+        return false;
+    }
+
+    std::unique_ptr<juce::AudioFormat> format;
+    if (file.hasFileExtension(".flac"))
+        format = std::make_unique<juce::FlacAudioFormat>();
+    else
+        format = std::make_unique<juce::WavAudioFormat>();
+
+    file.deleteFile();
+
+    // the big buffer turns the encoder's small writes into long sequential
+    // ones; the WAV writer switches to RF64 by itself past 4GB
+    auto stream = std::make_unique<juce::FileOutputStream>(file, outputBufferBytes);
+    if (stream->failedToOpen())
+    {
+        error = "Couldn't create " + file.getFullPathName() + ": " + stream->getStatus().getErrorMessage();
+        return false;
+    }
+
+    writer.reset(format->createWriterFor(stream.get(), sampleRate, (unsigned int)numChannels,
+                                         bitsPerSample, {}, 0));
+    if (writer == nullptr)
+    {
+        error = "Couldn't write " + format->getFormatName() + " at " + juce::String(bitsPerSample) + " bits";
+        return false;
+    }
+
+    stream.release(); // the writer owns it now
+
+    // no pushes can be in flight here, so the ring can be reallocated
+    const int capacity = juce::roundToInt(sampleRate * fifoSeconds);
+    ring.setSize(numChannels, capacity);
+    fifo.setTotalSize(capacity);
+    fifo.reset();
+
+    currentFile = file;
+    recordingSampleRate = sampleRate;
+    samplesWritten.store(0);
+    droppedSamples.store(0);
+    writeFailed.store(false);
+
+    startThread(juce::Thread::Priority::high);
+    recording.store(true);
+    return true;
+}
+
+void MasterRecorder::stop()
+{
+    if (!recording.exchange(false))
+        return;
+
+    // a block that saw recording set may still be copying in
+    while (pushesInFlight.load() != 0)
+        juce::Thread::yield();
+
+    // the thread drains the FIFO on its way out, however long that takes
+    signalThreadShouldExit();
+    notify();
+    waitForThreadToExit(-1);
+
+    // closing the writer fills in the header's sizes
+    writer.reset();
+}
+
+void MasterRecorder::push(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    pushesInFlight.fetch_add(1);
+
+    const int sourceChannels = buffer.getNumChannels();
+
+    if (recording.load() && sourceChannels > 0)
+    {
+        const int toWrite = juce::jmin(numSamples, fifo.getFreeSpace());
+        const auto scope = fifo.write(toWrite);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const int source = juce::jmin(channel, sourceChannels - 1);
+
+            if (scope.blockSize1 > 0)
+                ring.copyFrom(channel, scope.startIndex1, buffer, source, startSample, scope.blockSize1);
+
+            if (scope.blockSize2 > 0)
+                ring.copyFrom(channel, scope.startIndex2, buffer, source, startSample + scope.blockSize1, scope.blockSize2);
+        }
+
+        if (toWrite < numSamples)
+            droppedSamples.fetch_add(numSamples - toWrite);
+    }
+
+    pushesInFlight.fetch_sub(1);
+}
+
+double MasterRecorder::getRecordedSeconds() const
+{
+    return recordingSampleRate > 0.0 ? (double)samplesWritten.load() / recordingSampleRate : 0.0;
+}
+
+void MasterRecorder::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(writeIntervalMilliseconds);
+        writePending(false);
+    }
+
+    writePending(true);
+}
+
+void MasterRecorder::writePending(bool flushEverything)
+{
+    // waiting for a worthwhile amount keeps each write long and sequential
+    const int minimumWrite = flushEverything ? 1 : juce::roundToInt(recordingSampleRate * minimumWriteSeconds);
+
+    auto writeBlock = [this](int start, int size)
+    {
+        if (size <= 0)
+            return;
+
+        // after a failure the FIFO is still drained, so the audio thread
+        // doesn't see it fill up, but nothing more goes to the file
+        if (!writeFailed.load())
+        {
+            const float* channels[numChannels] = { ring.getReadPointer(0, start), ring.getReadPointer(1, start) };
+
+            if (!writer->writeFromFloatArrays(channels, numChannels, size))
+                writeFailed.store(true);
+        }
+
+        samplesWritten.fetch_add(size);
+    };
+
+    while (fifo.getNumReady() >= minimumWrite)
+    {
+        // straight out of the ring, with no intermediate copy
+        const auto scope = fifo.read(fifo.getNumReady());
+        writeBlock(scope.startIndex1, scope.blockSize1);
+        writeBlock(scope.startIndex2, scope.blockSize2);
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Records the master mix to a WAV or FLAC file. The audio thread copies each
+// block into a FIFO sized to hold several seconds and carries on; a writer
+// thread of its own drains it in large chunks and encodes them through a
+// big output buffer, so the disk sees long sequential writes and the
+// callback never allocates, locks or touches the file. Everything the FIFO
+// and the writer need is allocated in start(), before recording is armed.
+// If the disk stalls for longer than the FIFO holds, the samples that don't
+// fit are counted rather than waited for.
+class MasterRecorder : private juce::Thread
+{
+public:
+    static constexpr int numChannels = 2;
+
+    MasterRecorder();
+    ~MasterRecorder() override;
+
+    // Message thread. The format follows the extension: .flac, or WAV for
+    // anything else. On failure returns false with the reason in error.
+    bool start(const juce::File& file, double sampleRate, int bitsPerSample, juce::String& error);
+
+    // Message thread. Waits for everything already captured to be written,
+    // then closes the file.
+    void stop();
+
+    bool isRecording() const { return recording.load(); }
+    juce::File getFile() const { return currentFile; }
+
+    // Audio thread. A mono buffer is recorded to both channels.
+    void push(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    double getRecordedSeconds() const;
+    juce::int64 getDroppedSamples() const { return droppedSamples.load(); }
+    bool hasWriteFailed() const { return writeFailed.load(); }
+
+private:
+    void run() override;
+    void writePending(bool flushEverything);
+
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    juce::File currentFile;
+    double recordingSampleRate = 0.0;
+
+    juce::AbstractFifo fifo{ 1 };
+    juce::AudioBuffer<float> ring;
+
+    std::atomic<bool> recording{ false };
+    std::atomic<int> pushesInFlight{ 0 };   // lets stop() know the audio thread has let go
+    std::atomic<juce::int64> samplesWritten{ 0 };
+    std::atomic<juce::int64> droppedSamples{ 0 };
+    std::atomic<bool> writeFailed{ false };
+
+    static constexpr double fifoSeconds = 20.0;
+    static constexpr double minimumWriteSeconds = 0.25;
+    static constexpr int writeIntervalMilliseconds = 50;
+    static constexpr size_t outputBufferBytes = 1 << 20;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MasterRecorder)
+};
@@ -0,0 +1,155 @@
+#include "PeakLimiter.h"
+
+namespace
+{
+    constexpr double lookaheadSeconds = 0.0015;
+    constexpr double releaseSeconds = 0.08;
+
+    // the 4-point midpoint interpolator's gain is 20/16 at most
+    constexpr float interpolationHeadroom = 1.25f;
+}
+
+void PeakLimiter::prepare(double sampleRate, int maximumBlockSize)
+{
+    lookahead = juce::jmax(4, juce::roundToInt(sampleRate * lookaheadSeconds));
+
+    // the midpoint of samples n - 2 and n - 1 is only known at n, so its
+    // gain arrives two samples late; the extra delay and hold cover that
+    delay = lookahead + 2;
+    holdLength = lookahead + 3;
+    maxChunk = juce::jmax(256, maximumBlockSize);
+    releaseCoefficient = 1.0f - std::exp(-1.0f / (float)(sampleRate * releaseSeconds));
+
+    delayLine.setSize(maxChannels, delay + maxChunk);
+    holdSamples.resize((size_t)holdLength + 1);
+    holdGains.resize((size_t)holdLength + 1);
+    average.resize((size_t)lookahead);
+    reset();
+}
+
+void PeakLimiter::reset()
+{
+    delayLine.clear();
+    leaveIdle();
+    idle = true;
+}
+
+void PeakLimiter::leaveIdle()
+{
+    // everything that went through while idle needed no reduction, so the
+    // envelope starts from unity
+    holdHead = holdSize = 0;
+    std::fill(average.begin(), average.end(), 1.0f);
+    averagePosition = 0;
+    averageSum = (double)average.size();
+    envelope = gain = 1.0f;
+    samplesAtUnity = 0;
+    idle = false;
+}
+
+void PeakLimiter::process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    if (maxChunk == 0)
+        return;
+
+    for (int done = 0; done < numSamples;)
+    {
+        const int chunk = juce::jmin(numSamples - done, maxChunk);
+        processChunk(buffer, startSample + done, chunk);
+        done += chunk;
+    }
+}
+
+void PeakLimiter::processChunk(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    const int numChannels = juce::jmin(maxChannels, buffer.getNumChannels());
+    float peak = 0.0f;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        delayLine.copyFrom(channel, delay, buffer, channel, startSample, numSamples);
+        peak = juce::jmax(peak, buffer.getMagnitude(channel, startSample, numSamples));
+    }
+
+    if (idle && (!enabled || peak * interpolationHeadroom < ceiling))
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+            buffer.copyFrom(channel, startSample, delayLine, channel, 0, numSamples);
+    }
+    else
+    {
+        if (idle)
+            leaveIdle();
+
+        const float* in[maxChannels] = {};
+        float* out[maxChannels] = {};
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            in[channel] = delayLine.getReadPointer(channel);
+            out[channel] = buffer.getWritePointer(channel, startSample);
+        }
+
+        const int ringSize = (int)holdGains.size();
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const int n = delay + i;
+            float samplePeak = 0.0f;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const float* x = in[channel];
+                const float midpoint = (9.0f * (x[n - 2] + x[n - 1]) - x[n - 3] - x[n]) * (1.0f / 16.0f);
+                samplePeak = juce::jmax(samplePeak, std::abs(x[n]), std::abs(midpoint));
+            }
+
+            const float required = enabled && samplePeak > ceiling ? ceiling / samplePeak : 1.0f;
+
+            // sliding minimum over the last holdLength samples
+            while (holdSize > 0 && holdGains[(size_t)((holdHead + holdSize - 1) % ringSize)] >= required)
+                --holdSize;
+
+            holdSamples[(size_t)((holdHead + holdSize) % ringSize)] = sampleCounter;
+            holdGains[(size_t)((holdHead + holdSize) % ringSize)] = required;
+            ++holdSize;
+
+            if (holdSamples[(size_t)holdHead] <= sampleCounter - holdLength)
+            {
+                holdHead = (holdHead + 1) % ringSize;
+                --holdSize;
+            }
+
+            ++sampleCounter;
+
+            // instant attack, since the hold and average already smooth it;
+            // an exponential release back up
+            const float held = holdGains[(size_t)holdHead];
+            envelope = held < envelope ? held : envelope + (held - envelope) * releaseCoefficient;
+
+            averageSum += envelope - average[(size_t)averagePosition];
+            average[(size_t)averagePosition] = envelope;
+            if (++averagePosition == lookahead)
+                averagePosition = 0;
+
+            gain = juce::jmin(1.0f, (float)(averageSum / lookahead));
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                out[channel][i] = in[channel][i] * gain;
+
+            samplesAtUnity = required == 1.0f && gain > 0.99999f ? samplesAtUnity + 1 : 0;
+        }
+
+        // once the whole window has been at unity there's nothing to undo
+        if (samplesAtUnity > holdLength + lookahead)
+        {
+            idle = true;
+            gain = 1.0f;
+        }
+    }
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* d = delayLine.getWritePointer(channel);
+        std::memmove(d, d + numSamples, (size_t)delay * sizeof(float));
+    }
+}
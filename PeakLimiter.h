@@ -0,0 +1,71 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Look-ahead limiter that keeps a deck under a true-peak ceiling after its
+// loudness-normalisation gain has been applied. The peak between each pair
+// of samples is estimated by 4-point interpolation, the gain needed is held
+// over the look-ahead window with a sliding minimum and then averaged over
+// the same window, so the gain is already down when a peak comes out and
+// never moves in a step. While nothing comes near the ceiling the audio is
+// only delayed, with a few vector copies a block.
+// The delay is there whether or not the limiter is enabled, so switching it
+// on and off never shifts the audio in time; disabling it only lets any
+// reduction in progress release.
+// Works on the first maxChannels channels. Audio thread only, apart from
+// prepare().
+class PeakLimiter
+{
+public:
+    static constexpr int maxChannels = 2;
+
+    void prepare(double sampleRate, int maximumBlockSize);
+
+    // Forgets the delayed audio and any gain reduction in progress.
+    void reset();
+
+    void setCeiling(float ceilingDecibels) { ceiling = juce::Decibels::decibelsToGain(ceilingDecibels); }
+
+    // While disabled the audio is only delayed.
+    void setEnabled(bool shouldBeEnabled) { enabled = shouldBeEnabled; }
+    bool isEnabled() const { return enabled; }
+
+    void process(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    // delay the limiter adds, in samples
+    int getLatency() const { return delay; }
+    float getGainReduction() const { return 1.0f - gain; }
+
+private:
+    void processChunk(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void leaveIdle();
+
+    int lookahead = 0;      // samples the gain is averaged over
+    int delay = 0;          // lookahead plus the interpolator's own delay
+    int holdLength = 0;     // samples the sliding minimum covers
+    int maxChunk = 0;
+    float ceiling = juce::Decibels::decibelsToGain(-1.0f);
+    float releaseCoefficient = 0.0f;
+
+    juce::AudioBuffer<float> delayLine;   // delay samples of history, then the current chunk
+
+    // sliding minimum of the required gain: a ring of (sample, gain) pairs,
+    // increasing in both
+    std::vector<juce::int64> holdSamples;
+    std::vector<float> holdGains;
+    int holdHead = 0;
+    int holdSize = 0;
+
+    // moving average of the held gain
+    std::vector<float> average;
+    int averagePosition = 0;
+    double averageSum = 0.0;
+
+    juce::int64 sampleCounter = 0;
+    float envelope = 1.0f;
+    float gain = 1.0f;
+    int samplesAtUnity = 0;
+    bool idle = true;
+    bool enabled = true;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PeakLimiter)
+};
@@ -1,109 +1,849 @@
 ﻿#include "PlayerAudio.h"
+#include "AudioProfiler.h"
+#include "LibraryIndex.h"
+
+namespace
+{
+    // Latency of an MP3 decoder, in samples, on top of the encoder delay that
+    // LAME records. The Layer III synthesis filterbank is 528 samples deep and
+    // the first output sample it produces is one further in, which is the
+    // figure LAME's own gapless spec uses. JUCE's MP3 decoder doesn't trim it,
+    // so it is added to the recorded delay and taken off the recorded padding.
+    // It applies only to the Layer III header read below; iTunSMPB values
+    // already count the whole priming, so they're used as they stand.
+    constexpr int mp3DecoderDelay = 528 + 1;
+
+    // Encoder delay and padding, so that gapless hand-offs land on the first
+    // and last real samples rather than on the codec's priming silence.
+    // MP3s carry them in LAME's extension of the Xing/Info frame, AAC/ALAC
+    // files in iTunes' iTunSMPB tag.
+    void readGaplessInfo(const juce::File& file, const juce::StringPairArray& metadata,
+                         juce::int64& leadingTrim, juce::int64& trailingTrim)
+    {
+        const auto smpb = metadata.getValue("iTunSMPB", {});
+        if (smpb.isNotEmpty())
+        {
+            auto tokens = juce::StringArray::fromTokens(smpb.trim(), " ", {});
+            tokens.removeEmptyStrings();
+            if (tokens.size() >= 3)
+            {
+                leadingTrim = tokens[1].getHexValue64();
+                trailingTrim = tokens[2].getHexValue64();
+            }
+            return;
+        }
+
+        if (!file.hasFileExtension(".mp3"))
+            return;
+
+        juce::FileInputStream in(file);
+        if (in.failedToOpen())
+            return;
+
+        juce::uint8 id3[10] = {};
+        if (in.read(id3, 10) == 10 && id3[0] == 'I' && id3[1] == 'D' && id3[2] == '3')
+        {
+            const juce::int64 tagSize = ((id3[6] & 0x7f) << 21) | ((id3[7] & 0x7f) << 14)
+                                      | ((id3[8] & 0x7f) << 7) | (id3[9] & 0x7f);
+            in.setPosition(10 + tagSize + ((id3[5] & 0x10) != 0 ? 10 : 0));
+        }
+        else
+        {
+            in.setPosition(0);
+        }
+
+        juce::uint8 data[4096] = {};
+        const int numRead = in.read(data, (int)sizeof(data));
+
+        int frame = 0;
+        while (frame + 4 < numRead && !(data[frame] == 0xff && (data[frame + 1] & 0xe0) == 0xe0))
+            ++frame;
+
+        if (frame + 4 >= numRead || ((data[frame + 1] >> 1) & 3) != 1)
+            return; // not a Layer III frame
+
+        const bool mpeg1 = ((data[frame + 1] >> 3) & 3) == 3;
+        const bool mono = ((data[frame + 3] >> 6) & 3) == 3;
+        const int sideInfoSize = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+
+        int pos = frame + 4 + sideInfoSize;
+        if (pos + 8 > numRead
+            || !(std::memcmp(data + pos, "Xing", 4) == 0 || std::memcmp(data + pos, "Info", 4) == 0))
+            return;
+
+        const auto flags = juce::ByteOrder::bigEndianInt(data + pos + 4);
+        pos += 8;
+        if ((flags & 1) != 0) pos += 4;   // frame count
+        if ((flags & 2) != 0) pos += 4;   // byte count
+        if ((flags & 4) != 0) pos += 100; // seek table
+        if ((flags & 8) != 0) pos += 4;   // quality
+
+        if (pos + 24 > numRead
+            || !(std::memcmp(data + pos, "LAME", 4) == 0 || std::memcmp(data + pos, "Lavc", 4) == 0
+                 || std::memcmp(data + pos, "Lavf", 4) == 0))
+            return;
+
+        const int delay = (data[pos + 21] << 4) | (data[pos + 22] >> 4);
+        const int padding = ((data[pos + 22] & 0x0f) << 8) | data[pos + 23];
+
+        // the recorded values are the encoder's alone; see mp3DecoderDelay
+        leadingTrim = delay + mp3DecoderDelay;
+        trailingTrim = juce::jmax(0, padding - mp3DecoderDelay);
+    }
+
+    // WAV and AIFF PCM can be played straight out of a mapping of the file;
+    // everything else, or a file too big to map, goes through a decoder.
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> createMappedReader(juce::AudioFormatManager& fm,
+                                                                          const juce::File& file)
+    {
+        auto* format = fm.findFormatForFileExtension(file.getFileExtension());
+        if (format == nullptr)
+            return nullptr;
+
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader(format->createMemoryMappedReader(file));
+        if (reader == nullptr || reader->lengthInSamples <= 0 || !reader->mapEntireFile()
+            || reader->getMappedSection().getLength() < reader->lengthInSamples)
+            return nullptr;
+
+        return reader;
+    }
+}
 
 PlayerAudio::PlayerAudio(juce::AudioFormatManager& fm)
     : formatManager(fm)
 {
-    transportSource.addChangeListener(this);
+    hotCueSeconds.fill(-1.0);
+    startTimerHz(20);
 }
 
 
 PlayerAudio::~PlayerAudio()
 {
-    transportSource.removeChangeListener(this);
-    transportSource.setSource(nullptr);
+    stopTimer();
+
+    if (library != nullptr)
+        (*library)->removeChangeListener(this);
+
+    for (auto& slot : slots)
+        slot.transport.setSource(nullptr);
+
     releaseResources();
 }
 
 void PlayerAudio::setLooping(bool shouldLoop)
 {
-    transportSource.setLooping(shouldLoop);
+    loopingEnabled = shouldLoop;
+    pushCommand(CommandType::setLooping, shouldLoop ? 1.0 : 0.0);
 }
 
 void PlayerAudio::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
-    resamplingSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
-    transportSource.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    stretcher.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    eq.prepare(sampleRate);
+    jumpFade.setSize(DecodedSegment::numChannels, juce::jmax(1, juce::roundToInt(loopCrossfadeSeconds * sampleRate)));
+    jumpFadeLength = jumpFadePosition = jumpFade.getNumSamples();
+    outputGain.reset(sampleRate, GainRamp::defaultRampSeconds, muted.load() ? 0.0f : currentGain.load());
+    limiter.prepare(sampleRate, samplesPerBlockExpected);
+    limiter.setCeiling(limiterCeilingDb);
+    outputTap.prepare(sampleRate);
+    limiterRunning = false;
+    for (auto& slot : slots)
+        slot.transport.prepareToPlay(samplesPerBlockExpected, sampleRate);
+    preparedBlockSize.store(samplesPerBlockExpected);
+    preparedSampleRate.store(sampleRate);
+    prepared.store(true);
 }
 
 void PlayerAudio::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
 {
-    if (readerSource.get() == nullptr)
+    processPendingCommands();
+
+    if (!sourceAttached || !(running || fadeOut))
     {
         bufferToFill.clearActiveBufferRegion();
+        outputTap.push(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+        limiterRunning = false;
         return;
     }
 
-    resamplingSource.getNextAudioBlock(bufferToFill);
+    // one resampling stage covers both the speed control and the file rate,
+    // unless key lock hands the speed to the time-stretcher
+    const double fileSampleRate = getActiveSlot().sampleRate;
+    const double deviceSampleRate = preparedSampleRate.load(std::memory_order_relaxed);
+    if (fileSampleRate > 0.0 && deviceSampleRate > 0.0)
+        varispeed.setRatio((stretcher.isEnabled() ? 1.0 : speed) * fileSampleRate / deviceSampleRate);
+
+    stretcher.setTempo(speed);
+    stretcher.getNextAudioBlock(bufferToFill);
+
+    if (auto* prefetcher = getActiveSlot().prefetcher.get())
+        prefetcher->setPlayhead(activeTransport().getNextReadPosition());
+
+    {
+        AudioProfiler::ScopedStage eqStage(AudioProfiler::Stage::eq);
+        eq.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+    }
+
+    AudioProfiler::ScopedStage gainStage(AudioProfiler::Stage::gain);
+
+    const float gain = muted.load(std::memory_order_relaxed) ? 0.0f
+                                                             : currentGain.load(std::memory_order_relaxed);
+
+    // volume, mute and a new track's normalisation all glide to their new
+    // level rather than stepping
+    const bool normalise = normalising.load(std::memory_order_relaxed);
+    const float normalisation = normalise ? getActiveSlot().normalisationGain.load(std::memory_order_relaxed) : 1.0f;
+    outputGain.setTarget(gain * normalisation);
+
+    // starting and pausing also fade over one block instead of cutting the
+    // waveform, in the same pass as the gain
+    const int numChannels = bufferToFill.buffer->getNumChannels();
+    if (fadeOut)
+    {
+        outputGain.apply(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples, numChannels, 1.0f, 0.0f);
+        fadeOut = false;
+    }
+    else if (fadeIn)
+    {
+        outputGain.apply(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples, numChannels, 0.0f, 1.0f);
+        fadeIn = false;
+    }
+    else
+    {
+        outputGain.apply(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples, numChannels);
+    }
+
+    // The limiter's delay stays in the path whether or not it's limiting,
+    // so turning normalisation on or off never shifts the audio; switching
+    // off only lets any reduction release.
+    // Starting afresh, rather than with whatever was in the delay line
+    // when the deck last stopped.
+    if (!limiterRunning)
+        limiter.reset();
 
-    
-    bufferToFill.buffer->applyGain(bufferToFill.startSample, bufferToFill.numSamples, currentGain);
+    limiterRunning = true;
+    limiter.setEnabled(normalise);
+    limiter.process(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+
+    outputTap.push(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples);
+
+    // the transport stops itself when it runs off the end of the file
+    if (running && !activeTransport().isPlaying())
+    {
+        running = false;
+        playing.store(false);
+    }
 }
 
 void PlayerAudio::releaseResources()
 {
-    resamplingSource.releaseResources();
-    transportSource.releaseResources();
+    prepared.store(false);
+    stretcher.releaseResources();
+    for (auto& slot : slots)
+        slot.transport.releaseResources();
 }
 
-void PlayerAudio::loadFile(const juce::File& file)
+bool PlayerAudio::pushCommand(const Command& command)
 {
-    auto* reader = formatManager.createReaderFor(file);
-    if (reader != nullptr)
+    // A full queue means the callback has fallen behind; give it a few
+    // blocks to catch up rather than losing a seek or a source change. With
+    // the device stopped nothing drains it, so there's no point waiting.
+    const auto startTime = juce::Time::getMillisecondCounter();
+
+    while (!commandQueue.push(command))
     {
-        metadata = {};
-        auto newSource = std::make_unique<juce::AudioFormatReaderSource>(reader, true);
-        transportSource.setSource(newSource.get(), 0, nullptr, reader->sampleRate);
-        readerSource.reset(newSource.release());
+        if (!prepared.load() || juce::Time::getMillisecondCounter() - startTime > commandRetryMilliseconds)
+        {
+            jassertfalse;
+            return false;
+        }
 
-        
-        juce::StringPairArray md = reader->metadataValues;
-        juce::String title = md.getValue("title", "");
-        juce::String artist = md.getValue("artist", "");
-        if (title.isNotEmpty() || artist.isNotEmpty())
-            metadata = (title.isNotEmpty() ? ("Title: " + title + "\n") : "") + (artist.isNotEmpty() ? ("Artist: " + artist + "\n") : "");
-        metadata += "Duration: " + juce::String(reader->lengthInSamples / reader->sampleRate, 2) + "s";
+        juce::Thread::sleep(1);
     }
+
+    return true;
+}
+
+bool PlayerAudio::pushCommand(CommandType type, double value)
+{
+    Command command;
+    command.type = type;
+    command.value = value;
+    return pushCommand(command);
+}
+
+void PlayerAudio::startTransport()
+{
+    // AudioTransportSource::start() takes the transport's lock and posts a
+    // change message, so it happens here rather than on the audio thread.
+    // A started transport doesn't move until the audio thread is running.
+    auto& transport = activeTransport();
+    if (!transport.isPlaying())
+        transport.start();
+}
+
+void PlayerAudio::processPendingCommands()
+{
+    Command command;
+    while (commandQueue.pop(command))
+        applyCommand(command);
+}
+
+void PlayerAudio::applyCommand(const Command& command)
+{
+    switch (command.type)
+    {
+    case CommandType::play:
+        fadeIn = !running;
+        running = true;
+        playing.store(true);
+        break;
+
+    case CommandType::pause:
+        fadeOut = running;
+        running = false;
+        break;
+
+    case CommandType::stop:
+        fadeOut = false;
+        running = false;
+        leaveLoopSegment(false);
+        leaveCueSegment(false);
+        seekTo(0.0);
+        break;
+
+    case CommandType::restart:
+        leaveLoopSegment(false);
+        leaveCueSegment(false);
+        seekTo(0.0);
+        if (command.value > 0.0)
+        {
+            running = true;
+            playing.store(true);
+        }
+        break;
+
+    case CommandType::goToStart:
+        leaveLoopSegment(false);
+        leaveCueSegment(false);
+        seekTo(0.0);
+        break;
+
+    case CommandType::goToEnd:
+    {
+        leaveLoopSegment(false);
+        leaveCueSegment(false);
+        auto len = getTotalLength();
+        if (len > 0.1)
+            seekTo(len - 0.05);
+        break;
+    }
+
+    case CommandType::setPosition:
+        leaveLoopSegment(false);
+        leaveCueSegment(false);
+        seekTo(command.value);
+        break;
+
+    case CommandType::setSpeed:
+        speed = command.value;
+        break;
+
+    case CommandType::setResamplingQuality:
+        varispeed.setQuality((VarispeedSource::Quality)(int)command.value);
+        break;
+
+    case CommandType::setKeyLock:
+        stretcher.setEnabled(command.value > 0.0);
+        break;
+
+    case CommandType::setLooping:
+        // set on the reader itself: the read-ahead buffer follows its source's looping flag
+        wholeFileLooping = command.value > 0.0;
+        if (getActiveSlot().readerSource != nullptr)
+            getActiveSlot().readerSource->setLooping(wholeFileLooping);
+        break;
+
+    case CommandType::setLoopPoints:
+        leaveLoopSegment(true);
+        loopStart = command.rangeStart;
+        loopEnd = command.rangeEnd;
+        break;
+
+    case CommandType::setLoopEnabled:
+        if (command.value <= 0.0)
+            leaveLoopSegment(true);
+        loopEnabled = command.value > 0.0;
+        break;
+
+    case CommandType::setLoopSegment:
+        leaveLoopSegment(true);
+        loopSegment = command.segment;
+        break;
+
+    case CommandType::setHotCueSegment:
+        hotCueSegments[(size_t)command.value] = command.segment;
+        break;
+
+    case CommandType::triggerHotCue:
+    {
+        // Render what would have played next and fade out of it over the
+        // start of the cue, as the loop segments do at their wrap, rather
+        // than cutting from one to the other.
+        if (running && jumpFadeLength > 0)
+        {
+            jumpFade.clear();
+            renderSource(juce::AudioSourceChannelInfo(&jumpFade, 0, jumpFadeLength));
+            jumpFadePosition = 0;
+        }
+
+        leaveLoopSegment(false);
+        leaveCueSegment(false);
+
+        // With the cue's first second in RAM, the transport is sent to where
+        // that ends, so its read-ahead has the whole second to catch up. The
+        // A/B loop has its own RAM copy, so with it on this is a plain seek.
+        const auto& segment = hotCueSegments[(size_t)command.value];
+        const bool fromRam = segment != nullptr
+            && segment->startSample == command.rangeStart
+            && segment->sampleRate == getActiveSlot().sampleRate
+            && !(loopEnabled && loopEnd > loopStart);
+
+        activeTransport().setNextReadPosition(fromRam ? segment->getEndSample() : command.rangeStart);
+        varispeed.reset();
+        stretcher.reset();
+
+        if (fromRam)
+        {
+            cueSegment = segment;
+            cuePlayhead = 0;
+            loopPlayheadSample.store(segment->startSample);
+        }
+
+        fadeOut = false;
+        running = true;
+        playing.store(true);
+        break;
+    }
+
+    case CommandType::armNextSlot:
+        armedSlot = (int)command.value;
+        break;
+
+    case CommandType::disarmNextSlot:
+        armedSlot = -1;
+        handshakeAcknowledged.store((juce::uint32)command.value);
+        break;
+
+    case CommandType::detachSource:
+        jumpFadePosition = jumpFadeLength;
+        leaveLoopSegment(false);
+        leaveCueSegment(false);
+        loopSegment.reset();
+        for (auto& segment : hotCueSegments)
+            segment.reset();
+        loopEnabled = false;
+        sourceAttached = false;
+        running = false;
+        fadeIn = fadeOut = false;
+        armedSlot = -1;
+        handshakeAcknowledged.store((juce::uint32)command.value);
+        break;
+
+    case CommandType::attachSource:
+        varispeed.reset();
+        stretcher.reset();
+        sourceAttached = true;
+        break;
+    }
+}
+
+std::unique_ptr<PlayerAudio::LoadedSource> PlayerAudio::openSource(juce::AudioFormatManager& fm,
+                                                                  const juce::File& file,
+                                                                  int readAheadSize,
+                                                                  int blockSize,
+                                                                  double deviceSampleRate)
+{
+    // compressed files decode through the shared cache, so a track that's
+    // already been played, or is loaded on another deck, comes from RAM
+    juce::SharedResourcePointer<DecodedAudioCache> decodedCache;
+    auto mappedReader = createMappedReader(fm, file);
+    juce::AudioFormatReader* reader = mappedReader != nullptr ? mappedReader.release()
+                                                              : decodedCache->createReaderFor(fm, file);
+    if (reader == nullptr)
+        return nullptr;
+
+    auto loaded = std::make_unique<LoadedSource>();
+    loaded->sampleRate = reader->sampleRate;
+    loaded->lengthInSamples = reader->lengthInSamples;
+    loaded->file = file;
+
+    juce::StringPairArray md = reader->metadataValues;
+    juce::String title = md.getValue("title", "");
+    juce::String artist = md.getValue("artist", "");
+    if (title.isNotEmpty() || artist.isNotEmpty())
+        loaded->metadata = (title.isNotEmpty() ? ("Title: " + title + "\n") : "") + (artist.isNotEmpty() ? ("Artist: " + artist + "\n") : "");
+    loaded->metadata += "Duration: " + juce::String(reader->lengthInSamples / reader->sampleRate, 2) + "s";
+
+    readGaplessInfo(file, md, loaded->leadingTrim, loaded->trailingTrim);
+
+    loaded->readerSource = std::make_unique<juce::AudioFormatReaderSource>(reader, true);
+
+    if (auto* mapped = dynamic_cast<juce::MemoryMappedAudioFormatReader*>(reader))
+    {
+        // Reading from the mapping is a copy out of the page cache, so the
+        // audio thread can do it directly, as long as the pages are resident
+        // before it gets there. Fault in the start now, on this thread.
+        const auto window = (juce::int64)(mappedPrefetchSeconds * reader->sampleRate);
+        loaded->prefetcher = std::make_unique<MappedPrefetcher>(*mapped, loaded->diskThreads->getReadAheadThread(),
+                                                                juce::jmax((juce::int64)readAheadSize, window));
+        loaded->prefetcher->prefetchNow(0, window / 4);
+    }
+    else if (readAheadSize > 0)
+    {
+        // Prefilling here blocks whichever thread opened the file, which is
+        // the loader pool for loadFileAsync, rather than the message thread
+        // inside AudioTransportSource::setSource().
+        const bool canPrefill = blockSize > 0 && deviceSampleRate > 0.0;
+        loaded->bufferingSource = std::make_unique<juce::BufferingAudioSource>(loaded->readerSource.get(),
+                                                                               loaded->diskThreads->getReadAheadThread(),
+                                                                               false,
+                                                                               readAheadSize,
+                                                                               2,
+                                                                               canPrefill);
+        if (canPrefill)
+            loaded->bufferingSource->prepareToPlay(blockSize, deviceSampleRate);
+    }
+
+    return loaded;
+}
+
+void PlayerAudio::waitForAudioThread(CommandType handshake)
+{
+    // Ask the audio thread to let go of whatever the command covers and wait
+    // for it to say so, so that setSource() afterwards never contends with
+    // the callback. If the device isn't running there is nobody to answer,
+    // and nobody to contend with either.
+    const auto ticket = handshakeRequested.fetch_add(1) + 1;
+    pushCommand(handshake, (double)ticket);
+
+    const auto startTime = juce::Time::getMillisecondCounter();
+    while (prepared.load() && handshakeAcknowledged.load() < ticket
+           && juce::Time::getMillisecondCounter() - startTime < 500)
+        juce::Thread::sleep(1);
+}
+
+void PlayerAudio::swapSource(LoadedSource& loaded)
+{
+    handleTrackChanges();
+    waitForAudioThread(CommandType::detachSource);
+
+    playing.store(false);
+    paused.store(false);
+
+    // detaching also disarmed the queued track, which has to be queued again
+    // for whatever follows the new file
+    nextSlotArmed = false;
+    ++nextGeneration;
+
+    clearSlot(slots[1 - activeSlot.load()]);
+    installSource(getActiveSlot(), loaded);
+    ++loopGeneration;
+    resetHotCues();
+
+    pushCommand(CommandType::attachSource);
+}
+
+void PlayerAudio::installSource(TrackSlot& slot, LoadedSource& loaded)
+{
+    juce::PositionableAudioSource* newSource = loaded.bufferingSource != nullptr
+        ? static_cast<juce::PositionableAudioSource*>(loaded.bufferingSource.get())
+        : loaded.readerSource.get();
+
+    loaded.readerSource->setLooping(loopingEnabled);
+    slot.transport.setSource(newSource);
+
+    // the old buffering source and prefetcher use the old reader, so they have to go first
+    slot.bufferingSource = std::move(loaded.bufferingSource);
+    slot.prefetcher = std::move(loaded.prefetcher);
+    slot.readerSource = std::move(loaded.readerSource);
+    slot.metadata = loaded.metadata;
+    slot.file = loaded.file;
+    slot.sampleRate = loaded.sampleRate;
+    slot.endSample = loaded.trailingTrim > 0 ? loaded.lengthInSamples - loaded.trailingTrim : -1;
+    slot.loudness = normalising.load() ? lookUpLoudness(slot.file, true) : unknownLoudness;
+    updateNormalisationGain(slot);
+
+    if (loaded.leadingTrim > 0)
+        slot.transport.setNextReadPosition(loaded.leadingTrim);
+}
+
+void PlayerAudio::clearSlot(TrackSlot& slot)
+{
+    slot.transport.setSource(nullptr);
+    slot.bufferingSource.reset();
+    slot.prefetcher.reset();
+    slot.readerSource.reset();
+    slot.metadata = {};
+    slot.file = juce::File();
+    slot.sampleRate = 0.0;
+    slot.endSample = -1;
+    slot.loudness = unknownLoudness;
+    slot.normalisationGain = 1.0f;
+}
+
+double PlayerAudio::lookUpLoudness(const juce::File& file, bool addToLibrary)
+{
+    // only asked for once normalisation is on, so that players without a
+    // library, like the renderer's, never start one up
+    if (library == nullptr)
+    {
+        library = std::make_unique<juce::SharedResourcePointer<LibraryIndex>>();
+        (*library)->addChangeListener(this);
+    }
+
+    auto& index = library->getObject();
+    const int trackIndex = index.indexOf(file);
+
+    // a file opened from outside the library gets probed and analysed like
+    // any other; refreshLoudness() picks the result up
+    if (trackIndex < 0)
+    {
+        if (addToLibrary)
+        {
+            juce::Array<juce::File> files;
+            files.add(file);
+            index.addFiles(files);
+        }
+
+        return unknownLoudness;
+    }
+
+    const auto track = index.getTrack(trackIndex);
+    return track.analysed ? track.loudness : unknownLoudness;
+}
+
+void PlayerAudio::refreshLoudness()
+{
+    if (!normalising.load())
+        return;
+
+    // a track loaded before its analysis finished gets its gain now
+    for (auto& slot : slots)
+    {
+        if (slot.file == juce::File())
+            continue;
+
+        const double loudness = lookUpLoudness(slot.file, false);
+        if (loudness != slot.loudness)
+        {
+            slot.loudness = loudness;
+            updateNormalisationGain(slot);
+        }
+    }
+}
+
+void PlayerAudio::updateNormalisationGain(TrackSlot& slot)
+{
+    // silence measures as -70 LUFS too, and shouldn't be boosted
+    if (slot.loudness <= unknownLoudness)
+    {
+        slot.normalisationGain = 1.0f;
+        return;
+    }
+
+    const double db = juce::jlimit(-maxNormalisationCutDb, maxNormalisationBoostDb, targetLoudness - slot.loudness);
+    slot.normalisationGain = juce::Decibels::decibelsToGain((float)db);
+}
+
+void PlayerAudio::setLoudnessNormalisation(bool shouldNormalise)
+{
+    if (shouldNormalise && !normalising.load())
+    {
+        for (auto& slot : slots)
+        {
+            if (slot.file != juce::File())
+                slot.loudness = lookUpLoudness(slot.file, true);
+
+            updateNormalisationGain(slot);
+        }
+    }
+
+    normalising = shouldNormalise;
+}
+
+void PlayerAudio::setTargetLoudness(double lufs)
+{
+    targetLoudness = lufs;
+
+    for (auto& slot : slots)
+        updateNormalisationGain(slot);
+}
+
+void PlayerAudio::setNextFile(const juce::File& file)
+{
+    handleTrackChanges();
+
+    const auto generation = ++nextGeneration;
+
+    if (nextSlotArmed)
+    {
+        waitForAudioThread(CommandType::disarmNextSlot);
+        clearSlot(slots[1 - activeSlot.load()]);
+        nextSlotArmed = false;
+    }
+
+    if (!file.existsAsFile())
+        return;
+
+    juce::WeakReference<PlayerAudio> weakThis(this);
+    auto* fm = &formatManager;
+    const int blockSize = preparedBlockSize.load();
+    const double deviceSampleRate = preparedSampleRate.load();
+
+    // the next track has to survive a cold start at the hand-off, so buffer
+    // more of it than the current one would need
+    const int readAheadSize = readAheadSamples > 0
+        ? juce::jmax(readAheadSamples, (int)(nextTrackPrebufferSeconds * juce::jmax(44100.0, deviceSampleRate)))
+        : 0;
+
+    diskThreads->getLoaderPool().addJob([weakThis, generation, fm, file, readAheadSize,
+                                         blockSize, deviceSampleRate]
+    {
+        std::shared_ptr<LoadedSource> loaded = openSource(*fm, file, readAheadSize, blockSize, deviceSampleRate);
+
+        juce::MessageManager::callAsync([weakThis, generation, loaded]
+        {
+            auto* player = weakThis.get();
+            if (player == nullptr || loaded == nullptr)
+                return;
+
+            // retire the previous track first if we've just handed over from it
+            player->handleTrackChanges();
+
+            if (generation != player->nextGeneration || player->nextSlotArmed)
+                return;
+
+            const int idle = 1 - player->activeSlot.load();
+            auto& slot = player->slots[idle];
+            player->installSource(slot, *loaded);
+            slot.transport.start();
+
+            player->nextSlotArmed = true;
+            player->pushCommand(CommandType::armNextSlot, (double)idle);
+        });
+    });
+}
+
+void PlayerAudio::handleTrackChanges()
+{
+    const auto changes = trackChanges.load();
+    if (changes == handledTrackChanges)
+        return;
+
+    handledTrackChanges = changes;
+
+    // the audio thread never goes back to the slot it left, so it's ours again
+    clearSlot(slots[1 - activeSlot.load()]);
+    nextSlotArmed = false;
+    ++nextGeneration;
+    ++loopGeneration;
+    resetHotCues();
+
+    if (onTrackChanged != nullptr)
+        onTrackChanged();
+}
+
+void PlayerAudio::timerCallback()
+{
+    handleTrackChanges();
+}
+
+void PlayerAudio::loadFile(const juce::File& file)
+{
+    ++loadGeneration;
+
+    if (auto loaded = openSource(formatManager, file, readAheadSamples,
+                                 preparedBlockSize.load(), preparedSampleRate.load()))
+        swapSource(*loaded);
+}
+
+void PlayerAudio::loadFileAsync(const juce::File& file, std::function<void(bool)> onLoaded)
+{
+    const auto generation = ++loadGeneration;
+    juce::WeakReference<PlayerAudio> weakThis(this);
+    auto* fm = &formatManager;
+    const int readAheadSize = readAheadSamples;
+    const int blockSize = preparedBlockSize.load();
+    const double deviceSampleRate = preparedSampleRate.load();
+
+    diskThreads->getLoaderPool().addJob([weakThis, generation, fm, file, readAheadSize,
+                                         blockSize, deviceSampleRate, onLoaded]
+    {
+        std::shared_ptr<LoadedSource> loaded = openSource(*fm, file, readAheadSize, blockSize, deviceSampleRate);
+
+        juce::MessageManager::callAsync([weakThis, generation, loaded, onLoaded]
+        {
+            auto* player = weakThis.get();
+            if (player == nullptr || generation != player->loadGeneration)
+                return;
+
+            const bool ok = loaded != nullptr;
+            if (ok)
+                player->swapSource(*loaded);
+
+            if (onLoaded != nullptr)
+                onLoaded(ok);
+        });
+    });
 }
 
 void PlayerAudio::play()
 {
-    paused = false;
-    transportSource.start();
+    startTransport();
+
+    if (pushCommand(CommandType::play))
+    {
+        paused = false;
+        playing = true;
+    }
 }
 
 void PlayerAudio::pause()
 {
-    if (transportSource.isPlaying())
+    if (playing && pushCommand(CommandType::pause))
     {
         paused = true;
-        transportSource.stop();
+        playing = false;
     }
 }
 
 void PlayerAudio::stop()
 {
-    paused = false;
-    transportSource.stop();
-    transportSource.setPosition(0.0);
+    if (pushCommand(CommandType::stop))
+    {
+        paused = false;
+        playing = false;
+    }
 }
 
 void PlayerAudio::restart()
 {
-    transportSource.setPosition(0.0);
     if (!paused)
-        transportSource.start();
+        startTransport();
+
+    if (pushCommand(CommandType::restart, paused ? 0.0 : 1.0) && !paused)
+        playing = true;
 }
 
 void PlayerAudio::goToStart()
 {
-    transportSource.setPosition(0.0);
+    pushCommand(CommandType::goToStart);
 }
 
 void PlayerAudio::goToEnd()
 {
-    auto len = transportSource.getLengthInSeconds();
-    if (len > 0.1)
-        transportSource.setPosition(len - 0.05);
+    pushCommand(CommandType::goToEnd);
 }
 
 void PlayerAudio::setGain(float g)
@@ -113,55 +853,454 @@ void PlayerAudio::setGain(float g)
 
 void PlayerAudio::setSpeed(double ratio)
 {
-    resamplingSource.setResamplingRatio(ratio);
+    pushCommand(CommandType::setSpeed, ratio);
+}
+
+void PlayerAudio::setResamplingQuality(VarispeedSource::Quality quality)
+{
+    pushCommand(CommandType::setResamplingQuality, (double)(int)quality);
+}
+
+void PlayerAudio::setKeyLock(bool shouldLockKey)
+{
+    keyLocked = shouldLockKey;
+    pushCommand(CommandType::setKeyLock, shouldLockKey ? 1.0 : 0.0);
 }
 
 void PlayerAudio::setPosition(double pos)
 {
-    transportSource.setPosition(pos);
+    const auto& slot = getActiveSlot();
+    if (slot.prefetcher != nullptr)
+        slot.prefetcher->prefetchAround((juce::int64)(juce::jmax(0.0, pos) * slot.sampleRate));
+
+    pushCommand(CommandType::setPosition, pos);
 }
 
 double PlayerAudio::getCurrentPosition() const
 {
-    return transportSource.getCurrentPosition();
+    const auto& slot = getActiveSlot();
+    if (slot.sampleRate <= 0.0)
+        return 0.0;
+
+    const auto loopPosition = loopPlayheadSample.load();
+    if (loopPosition >= 0)
+        return (double)loopPosition / slot.sampleRate;
+
+    return (double)slot.transport.getNextReadPosition() / slot.sampleRate;
 }
 
 double PlayerAudio::getTotalLength() const
 {
-    return transportSource.getLengthInSeconds();
+    const auto& slot = getActiveSlot();
+    return slot.sampleRate > 0.0 ? (double)slot.transport.getTotalLength() / slot.sampleRate : 0.0;
 }
 
 bool PlayerAudio::isPlaying() const
 {
-    return transportSource.isPlaying();
+    return playing;
 }
 
 juce::String PlayerAudio::getMetadata() const
 {
-    return metadata;
+    return getActiveSlot().metadata;
 }
 
 void PlayerAudio::toggleMute()
 {
-    if (!muted)
+    muted.store(!muted.load());
+}
+
+void PlayerAudio::setLoopPoints(double startSeconds, double endSeconds)
+{
+    const double sampleRate = getActiveSlot().sampleRate;
+    loopStartSample = (juce::int64)std::llround(juce::jmax(0.0, startSeconds) * sampleRate);
+    loopEndSample = (juce::int64)std::llround(juce::jmax(0.0, endSeconds) * sampleRate);
+
+    Command command;
+    command.type = CommandType::setLoopPoints;
+    command.rangeStart = loopStartSample;
+    command.rangeEnd = loopEndSample;
+    pushCommand(command);
+
+    // the wrap jumps back to the start until the region is in RAM
+    if (auto* prefetcher = getActiveSlot().prefetcher.get())
+        prefetcher->prefetchAround(loopStartSample);
+
+    requestLoopSegment();
+}
+
+void PlayerAudio::setLoopEnabled(bool shouldLoop)
+{
+    pushCommand(CommandType::setLoopEnabled, shouldLoop ? 1.0 : 0.0);
+}
+
+void PlayerAudio::requestLoopSegment()
+{
+    const auto generation = ++loopGeneration;
+
+    // drop the RAM copy of the old region straight away; the audio thread
+    // keeps looping from the transport until the new one arrives
+    pushCommand(CommandType::setLoopSegment);
+
+    const double sampleRate = getActiveSlot().sampleRate;
+    const auto length = loopEndSample - loopStartSample;
+
+    const auto file = getActiveSlot().file;
+
+    if (!file.existsAsFile() || sampleRate <= 0.0 || length <= 0
+        || (double)length > maxLoopSecondsInRam * sampleRate)
+        return;
+
+    juce::WeakReference<PlayerAudio> weakThis(this);
+    auto* fm = &formatManager;
+    const auto start = loopStartSample;
+    const auto end = loopEndSample;
+    const int crossfadeSamples = juce::roundToInt(loopCrossfadeSeconds * sampleRate);
+
+    diskThreads->getLoaderPool().addJob([weakThis, generation, fm, file, start, end, sampleRate, crossfadeSamples]
     {
-        muted = true;
-        transportSource.setGain(0.0f);
+        auto segment = DecodedSegment::decodeLoop(*fm, file, start, end, sampleRate, crossfadeSamples);
+
+        juce::MessageManager::callAsync([weakThis, generation, segment]
+        {
+            auto* player = weakThis.get();
+            if (player == nullptr || segment == nullptr || generation != player->loopGeneration)
+                return;
+
+            player->releasePool.add(segment);
+
+            Command command;
+            command.type = CommandType::setLoopSegment;
+            command.segment = segment;
+            player->pushCommand(command);
+        });
+    });
+}
+
+void PlayerAudio::setHotCue(int index, double seconds)
+{
+    if (!juce::isPositiveAndBelow(index, numHotCues))
+        return;
+
+    hotCueSeconds[(size_t)index] = seconds >= 0.0 ? seconds : -1.0;
+    requestHotCueSegment(index);
+}
+
+double PlayerAudio::getHotCue(int index) const
+{
+    return juce::isPositiveAndBelow(index, numHotCues) ? hotCueSeconds[(size_t)index] : -1.0;
+}
+
+void PlayerAudio::triggerHotCue(int index)
+{
+    const double seconds = getHotCue(index);
+    const auto& slot = getActiveSlot();
+    if (seconds < 0.0 || slot.sampleRate <= 0.0)
+        return;
+
+    const auto cueSample = (juce::int64)std::llround(seconds * slot.sampleRate);
+
+    // the transport picks up a second after the cue
+    if (slot.prefetcher != nullptr)
+        slot.prefetcher->prefetchAround(cueSample + (juce::int64)(hotCueSecondsInRam * slot.sampleRate));
+
+    startTransport();
+
+    Command command;
+    command.type = CommandType::triggerHotCue;
+    command.value = (double)index;
+    command.rangeStart = cueSample;
+
+    if (pushCommand(command))
+    {
+        paused = false;
+        playing = true;
     }
-    else
+}
+
+void PlayerAudio::resetHotCues()
+{
+    // the audio thread has already dropped the old track's segments
+    hotCueSeconds.fill(-1.0);
+
+    for (auto& generation : hotCueGenerations)
+        ++generation;
+}
+
+void PlayerAudio::requestHotCueSegment(int index)
+{
+    const auto generation = ++hotCueGenerations[(size_t)index];
+
+    // forget the old cue's audio straight away; until the new one is
+    // decoded, triggering it seeks the transport
+    Command clear;
+    clear.type = CommandType::setHotCueSegment;
+    clear.value = (double)index;
+    pushCommand(clear);
+
+    const auto& slot = getActiveSlot();
+    const double sampleRate = slot.sampleRate;
+    const double seconds = hotCueSeconds[(size_t)index];
+    const auto file = slot.file;
+
+    if (seconds < 0.0 || sampleRate <= 0.0 || !file.existsAsFile())
+        return;
+
+    const auto start = (juce::int64)std::llround(seconds * sampleRate);
+    const auto end = juce::jmin(start + (juce::int64)(hotCueSecondsInRam * sampleRate), slot.transport.getTotalLength());
+    if (end <= start)
+        return;
+
+    juce::WeakReference<PlayerAudio> weakThis(this);
+    auto* fm = &formatManager;
+
+    diskThreads->getLoaderPool().addJob([weakThis, index, generation, fm, file, start, end, sampleRate]
     {
-        muted = false;
-        transportSource.setGain(currentGain);
+        auto segment = DecodedSegment::decode(*fm, file, start, end, sampleRate);
+
+        juce::MessageManager::callAsync([weakThis, index, generation, file, segment]
+        {
+            auto* player = weakThis.get();
+            if (player == nullptr || segment == nullptr || generation != player->hotCueGenerations[(size_t)index]
+                || player->getCurrentFile() != file)
+                return;
+
+            player->releasePool.add(segment);
+
+            Command command;
+            command.type = CommandType::setHotCueSegment;
+            command.value = (double)index;
+            command.segment = segment;
+            player->pushCommand(command);
+        });
+    });
+}
+
+void PlayerAudio::renderSourceBlock(const juce::AudioSourceChannelInfo& info)
+{
+    AudioProfiler::ScopedStage stage(AudioProfiler::Stage::decode);
+
+    renderSource(info);
+
+    if (jumpFadePosition < jumpFadeLength)
+        applyJumpFade(info);
+}
+
+void PlayerAudio::applyJumpFade(const juce::AudioSourceChannelInfo& info)
+{
+    const int count = juce::jmin(info.numSamples, jumpFadeLength - jumpFadePosition);
+    const int numChannels = juce::jmin(info.buffer->getNumChannels(), jumpFade.getNumChannels());
+    const float step = 1.0f / (float)jumpFadeLength;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* out = info.buffer->getWritePointer(channel, info.startSample);
+        const float* old = jumpFade.getReadPointer(channel, jumpFadePosition);
+
+        for (int i = 0; i < count; ++i)
+        {
+            const float t = (float)(jumpFadePosition + i + 1) * step;
+            out[i] = old[i] + t * (out[i] - old[i]);
+        }
     }
+
+    jumpFadePosition += count;
 }
 
-void PlayerAudio::changeListenerCallback(juce::ChangeBroadcaster* source)
+void PlayerAudio::renderSource(const juce::AudioSourceChannelInfo& info)
 {
-    if (source == &transportSource)
+    if (cueSegment != nullptr)
     {
-        if (!transportSource.isPlaying() && !paused)
+        if (!loopEnabled || loopEnd <= loopStart)
         {
-           
+            renderCueBlock(info);
+            return;
         }
+
+        // the A/B loop was switched on after the cue; it takes over from here
+        leaveCueSegment(true);
+    }
+
+    if (!loopEnabled || loopEnd <= loopStart)
+    {
+        leaveLoopSegment(true);
+        renderTransportBlock(info);
+        return;
+    }
+
+    auto* segment = loopSegment.get();
+    const bool segmentMatches = segment != nullptr
+        && segment->startSample == loopStart
+        && segment->getEndSample() == loopEnd
+        && segment->sampleRate == getActiveSlot().sampleRate;
+
+    if (segmentMatches)
+    {
+        if (!playingFromLoop)
+        {
+            const auto position = activeTransport().getNextReadPosition();
+            if (position >= loopStart && position < loopEnd)
+            {
+                playingFromLoop = true;
+                loopPlayhead = (int)(position - loopStart);
+            }
+        }
+
+        if (playingFromLoop)
+        {
+            renderLoopFromSegment(info, *segment);
+            return;
+        }
+    }
+
+    renderLoopFromTransport(info);
+}
+
+void PlayerAudio::renderTransportBlock(const juce::AudioSourceChannelInfo& info)
+{
+    auto& current = getActiveSlot();
+
+    if (armedSlot < 0 || wholeFileLooping)
+    {
+        current.transport.getNextAudioBlock(info);
+        return;
+    }
+
+    // Hand over to the queued track at the current one's last real sample,
+    // within this block. The next transport was started and pre-buffered on
+    // the message thread, so its first block is already waiting.
+    const auto end = current.endSample >= 0 ? current.endSample : current.transport.getTotalLength();
+    const auto position = current.transport.getNextReadPosition();
+    const int chunk = (int)juce::jlimit((juce::int64)0, (juce::int64)info.numSamples, end - position);
+
+    if (chunk > 0)
+        current.transport.getNextAudioBlock(juce::AudioSourceChannelInfo(info.buffer, info.startSample, chunk));
+
+    if (chunk == info.numSamples)
+        return;
+
+    activeSlot.store(armedSlot);
+    armedSlot = -1;
+    loopStart = loopEnd = 0;
+    loopSegment.reset();
+    for (auto& segment : hotCueSegments)
+        segment.reset();
+    trackChanges.fetch_add(1);
+
+    getActiveSlot().transport.getNextAudioBlock(juce::AudioSourceChannelInfo(info.buffer, info.startSample + chunk,
+                                                                             info.numSamples - chunk));
+}
+
+void PlayerAudio::seekTo(double seconds)
+{
+    auto& slot = getActiveSlot();
+    slot.transport.setNextReadPosition((juce::int64)(juce::jmax(0.0, seconds) * slot.sampleRate));
+    varispeed.reset();
+    stretcher.reset();
+}
+
+void PlayerAudio::renderLoopFromTransport(const juce::AudioSourceChannelInfo& info)
+{
+    // Until the region is in RAM, wrap by seeking the transport at the exact
+    // end sample. That's sample-accurate, but the read-ahead may not have the
+    // start of the loop buffered yet.
+    for (int done = 0; done < info.numSamples;)
+    {
+        const auto position = activeTransport().getNextReadPosition();
+        int chunk = info.numSamples - done;
+
+        const bool crossesEnd = position < loopEnd && position + chunk >= loopEnd;
+        if (crossesEnd)
+            chunk = (int)(loopEnd - position);
+
+        if (chunk > 0)
+            activeTransport().getNextAudioBlock(juce::AudioSourceChannelInfo(info.buffer, info.startSample + done, chunk));
+
+        if (crossesEnd)
+            activeTransport().setNextReadPosition(loopStart);
+
+        done += chunk;
     }
 }
+
+void PlayerAudio::renderLoopFromSegment(const juce::AudioSourceChannelInfo& info, const DecodedSegment& segment)
+{
+    const int length = segment.getNumSamples();
+    const int lastSourceChannel = segment.audio.getNumChannels() - 1;
+
+    for (int done = 0; done < info.numSamples;)
+    {
+        const int chunk = juce::jmin(info.numSamples - done, length - loopPlayhead);
+
+        for (int channel = 0; channel < info.buffer->getNumChannels(); ++channel)
+            info.buffer->copyFrom(channel, info.startSample + done, segment.audio,
+                                  juce::jmin(channel, lastSourceChannel), loopPlayhead, chunk);
+
+        done += chunk;
+        loopPlayhead += chunk;
+
+        if (loopPlayhead >= length)
+            loopPlayhead = 0;
+    }
+
+    loopPlayheadSample.store(segment.startSample + loopPlayhead);
+}
+
+void PlayerAudio::renderCueBlock(const juce::AudioSourceChannelInfo& info)
+{
+    const auto& segment = *cueSegment;
+    const int lastSourceChannel = segment.audio.getNumChannels() - 1;
+    const int chunk = juce::jmin(info.numSamples, segment.getNumSamples() - cuePlayhead);
+
+    for (int channel = 0; channel < info.buffer->getNumChannels(); ++channel)
+        info.buffer->copyFrom(channel, info.startSample, segment.audio,
+                              juce::jmin(channel, lastSourceChannel), cuePlayhead, chunk);
+
+    cuePlayhead += chunk;
+
+    if (cuePlayhead < segment.getNumSamples())
+    {
+        loopPlayheadSample.store(segment.startSample + cuePlayhead);
+        return;
+    }
+
+    // the transport has been waiting at the end of the segment all along
+    leaveCueSegment(false);
+
+    if (chunk < info.numSamples)
+        renderTransportBlock(juce::AudioSourceChannelInfo(info.buffer, info.startSample + chunk, info.numSamples - chunk));
+}
+
+void PlayerAudio::leaveCueSegment(bool continueFromPlayhead)
+{
+    if (cueSegment == nullptr)
+        return;
+
+    if (continueFromPlayhead)
+        activeTransport().setNextReadPosition(cueSegment->startSample + cuePlayhead);
+
+    cueSegment.reset();
+    loopPlayheadSample.store(-1);
+}
+
+void PlayerAudio::leaveLoopSegment(bool continueFromPlayhead)
+{
+    if (!playingFromLoop)
+        return;
+
+    // the transport sat still while we played from RAM, so pick it up where
+    // the loop playhead is rather than where we left it
+    if (continueFromPlayhead)
+        activeTransport().setNextReadPosition(loopStart + loopPlayhead);
+
+    playingFromLoop = false;
+    loopPlayheadSample.store(-1);
+}
+
+void PlayerAudio::changeListenerCallback(juce::ChangeBroadcaster* source)
+{
+    // the library is the only broadcaster we listen to; the end of a track
+    // is handled by the gapless hand-off
+    if (library != nullptr && source == library->get())
+        refreshLoudness();
+}
\ No newline at end of file
@@ -1,9 +1,24 @@
 ﻿#pragma once
 #include <JuceHeader.h>
+#include "LockFreeFifo.h"
+#include "DiskThreadPool.h"
+#include "DecodedSegment.h"
+#include "ReleasePool.h"
+#include "VarispeedSource.h"
+#include "TimeStretcher.h"
+#include "MappedPrefetcher.h"
+#include "DecodedAudioCache.h"
+#include "PeakLimiter.h"
+#include "GainRamp.h"
+#include "AudioTap.h"
+#include "DeckEq.h"
+
+class LibraryIndex;
 
 
 class PlayerAudio : public juce::AudioSource,
-    public juce::ChangeListener
+    public juce::ChangeListener,
+    private juce::Timer
 {
 public:
     PlayerAudio(juce::AudioFormatManager& formatManagerRef);
@@ -16,6 +31,25 @@ public:
 
     
     void loadFile(const juce::File& file);
+
+    // Opens and probes the file on the shared loader pool, then swaps it in on
+    // the message thread. onLoaded is called on the message thread with false
+    // if the file couldn't be opened; a newer load supersedes an older one.
+    void loadFileAsync(const juce::File& file, std::function<void(bool)> onLoaded = nullptr);
+
+    // Size of the read-ahead buffer, in samples, used for subsequently loaded
+    // files. 0 decodes directly on the audio thread.
+    void setReadAheadBufferSize(int numSamples) { readAheadSamples = juce::jmax(0, numSamples); }
+    int getReadAheadBufferSize() const { return readAheadSamples; }
+
+    // Gapless queue. The next file is opened and its first seconds buffered in
+    // the background; when the current track reaches its last sample (after
+    // any encoder padding) the audio thread carries straight on into it.
+    // onTrackChanged is called on the message thread after such a hand-off.
+    void setNextFile(const juce::File& file);
+    void clearNextFile() { setNextFile({}); }
+    std::function<void()> onTrackChanged;
+
     void play();
     void pause();
     void stop();
@@ -25,6 +59,31 @@ public:
 
     void setGain(float g);
     void setSpeed(double ratio);
+
+    // Loudness normalisation: every track is brought to the target loudness
+    // using the integrated loudness the library measured for it in the
+    // background, and a limiter keeps boosted tracks under -1 dBTP. Tracks
+    // the library hasn't analysed yet play at unity until their analysis
+    // arrives; files opened from outside the library are added to it.
+    void setLoudnessNormalisation(bool shouldNormalise);
+    bool isNormalisingLoudness() const { return normalising.load(); }
+    void setTargetLoudness(double lufs);
+    double getTargetLoudness() const { return targetLoudness; }
+
+    // Three-band kill EQ and the sweepable filter, ahead of the deck's gain.
+    // Changes glide in over a few milliseconds.
+    void setEqGain(DeckEq::Band band, float decibels) { eq.setBandGain(band, decibels); }
+    float getEqGain(DeckEq::Band band) const { return eq.getBandGain(band); }
+    void setFilter(float position) { eq.setFilter(position); }
+    float getFilter() const { return eq.getFilter(); }
+
+    // How the speed change and any file/device rate mismatch are resampled.
+    // Sinc by default; a ratio of exactly 1.0 always bypasses it.
+    void setResamplingQuality(VarispeedSource::Quality quality);
+
+    // Key lock: speed changes the tempo but not the pitch.
+    void setKeyLock(bool shouldLockKey);
+    bool isKeyLocked() const { return keyLocked; }
     void setPosition(double pos);
     double getCurrentPosition() const;
     double getTotalLength() const;
@@ -33,36 +92,263 @@ public:
     bool isMuted() const { return muted; }
 
     juce::String getMetadata() const;
+    juce::File getCurrentFile() const { return getActiveSlot().file; }
     juce::AudioFormatManager& getFormatManager() { return formatManager; }
-    juce::AudioSource& getAudioSourceAdapter() { return resamplingSource; }
+    juce::AudioSource& getAudioSourceAdapter() { return stretcher; }
 
     
     void toggleMute();
     void setLooping(bool shouldLoop);
 
+    // A/B loop. The points are converted to sample positions and enforced by
+    // the audio thread; the region is also decoded into RAM in the background
+    // so that, once it's ready, the wrap is seamless with a short crossfade.
+    void setLoopPoints(double startSeconds, double endSeconds);
+    void setLoopEnabled(bool shouldLoop);
+
+    // Hot cues, for the loaded track. The first second after each cue is
+    // decoded into RAM in the background as soon as it's set, so triggering
+    // one plays from memory on the very next block while the transport
+    // buffers on from where that audio ends, with a short crossfade out of
+    // whatever was playing. Triggering also starts playback. Cues are cleared whenever the track changes.
+    static constexpr int numHotCues = 8;
+    void setHotCue(int index, double seconds);
+    void clearHotCue(int index) { setHotCue(index, -1.0); }
+    double getHotCue(int index) const;   // -1 when not set
+    void triggerHotCue(int index);
+
     void changeListenerCallback(juce::ChangeBroadcaster* source) override;
-    float getOutputSample(int channel, int sampleIndex)
-    {
-        if (readerSource != nullptr)
-        {
-            auto* reader = readerSource->getAudioFormatReader();
-            if (reader != nullptr)
-                return 0.0f; 
-        }
-        return 0.0f;
-    }
+
+    // Everything the deck outputs, after its EQ, gain and limiter, for meters.
+    AudioTap& getOutputTap() { return outputTap; }
 
 private:
+    // Everything the message thread wants to change on the transport goes
+    // through this queue and is applied by the audio thread at the top of the
+    // next block, so the UI never takes a lock the callback also needs.
+    enum class CommandType
+    {
+        play,
+        pause,
+        stop,
+        restart,
+        goToStart,
+        goToEnd,
+        setPosition,
+        setSpeed,
+        setResamplingQuality,
+        setKeyLock,
+        setLooping,
+        setLoopPoints,
+        setLoopEnabled,
+        setLoopSegment,
+        setHotCueSegment,
+        triggerHotCue,
+        armNextSlot,
+        disarmNextSlot,
+        detachSource,
+        attachSource
+    };
+
+    struct Command
+    {
+        CommandType type = CommandType::play;
+        double value = 0.0;
+        juce::int64 rangeStart = 0;
+        juce::int64 rangeEnd = 0;
+        std::shared_ptr<DecodedSegment> segment;
+    };
+
+    // Sits between the speed resampler and the transport, so that loop
+    // playback from RAM happens on the transport's timeline. The transports
+    // run at their file's own rate; all resampling happens in one place, in
+    // the VarispeedSource above; with key lock on, the TimeStretcher above
+    // that handles the speed instead.
+    struct SourceStage : public juce::AudioSource
+    {
+        explicit SourceStage(PlayerAudio& p) : owner(p) {}
+
+        void prepareToPlay(int, double) override {}
+        void releaseResources() override {}
+        void getNextAudioBlock(const juce::AudioSourceChannelInfo& info) override { owner.renderSourceBlock(info); }
+
+        PlayerAudio& owner;
+    };
+
+    // A file opened off the message thread, ready to hand to the transport.
+    // Uncompressed files are memory-mapped and read in place on the audio
+    // thread, with a prefetcher instead of a read-ahead buffer.
+    struct LoadedSource
+    {
+        juce::SharedResourcePointer<DiskThreadPool> diskThreads;
+        std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
+        std::unique_ptr<juce::BufferingAudioSource> bufferingSource;
+        std::unique_ptr<MappedPrefetcher> prefetcher;
+        double sampleRate = 0.0;
+        juce::int64 lengthInSamples = 0;
+        juce::String metadata;
+        juce::File file;
+
+        // encoder delay and padding, in file samples, where the format tells us
+        juce::int64 leadingTrim = 0;
+        juce::int64 trailingTrim = 0;
+    };
+
+    // One of the two transports a deck alternates between for gapless
+    // hand-offs. The message thread only touches the slot the audio thread
+    // isn't playing, and only while it isn't armed as the next track.
+    struct TrackSlot
+    {
+        juce::AudioTransportSource transport;
+        std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
+        std::unique_ptr<juce::BufferingAudioSource> bufferingSource;
+        std::unique_ptr<MappedPrefetcher> prefetcher;
+        juce::File file;
+        juce::String metadata;
+        double sampleRate = 0.0;
+
+        // measured by the library, in LUFS; message thread only
+        double loudness = unknownLoudness;
+        std::atomic<float> normalisationGain{ 1.0f };
+
+        // where the hand-off to the next track happens, on the transport's
+        // timeline; -1 means the transport's own length
+        juce::int64 endSample = -1;
+    };
+
+    static std::unique_ptr<LoadedSource> openSource(juce::AudioFormatManager& formatManager,
+                                                    const juce::File& file,
+                                                    int readAheadSamples,
+                                                    int blockSize,
+                                                    double deviceSampleRate);
+
+    // False if the queue stayed full, which only happens when nothing is
+    // draining it.
+    bool pushCommand(const Command& command);
+    bool pushCommand(CommandType type, double value = 0.0);
+    void startTransport();
+    void processPendingCommands();
+    void applyCommand(const Command& command);
+    void waitForAudioThread(CommandType handshake);
+    void swapSource(LoadedSource& loaded);
+    void installSource(TrackSlot& slot, LoadedSource& loaded);
+    void clearSlot(TrackSlot& slot);
+    void updateNormalisationGain(TrackSlot& slot);
+    double lookUpLoudness(const juce::File& file, bool addToLibrary);
+    void refreshLoudness();
+    void handleTrackChanges();
+    void timerCallback() override;
+
+    TrackSlot& getActiveSlot() { return slots[activeSlot.load(std::memory_order_relaxed)]; }
+    const TrackSlot& getActiveSlot() const { return slots[activeSlot.load(std::memory_order_relaxed)]; }
+    juce::AudioTransportSource& activeTransport() { return getActiveSlot().transport; }
+    const juce::AudioTransportSource& activeTransport() const { return getActiveSlot().transport; }
+
+    void renderTransportBlock(const juce::AudioSourceChannelInfo& info);
+    void seekTo(double seconds);
+
+    void renderSourceBlock(const juce::AudioSourceChannelInfo& info);
+    void renderSource(const juce::AudioSourceChannelInfo& info);
+    void applyJumpFade(const juce::AudioSourceChannelInfo& info);
+    void renderLoopFromTransport(const juce::AudioSourceChannelInfo& info);
+    void renderLoopFromSegment(const juce::AudioSourceChannelInfo& info, const DecodedSegment& segment);
+    void leaveLoopSegment(bool continueFromPlayhead);
+    void requestLoopSegment();
+    void renderCueBlock(const juce::AudioSourceChannelInfo& info);
+    void leaveCueSegment(bool continueFromPlayhead);
+    void requestHotCueSegment(int index);
+    void resetHotCues();
+
     juce::AudioFormatManager& formatManager;
-    std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
-    juce::AudioTransportSource transportSource;
-    juce::ResamplingAudioSource resamplingSource{ &transportSource, false, 2 };
+    juce::SharedResourcePointer<DiskThreadPool> diskThreads;
+    juce::SharedResourcePointer<DecodedAudioCache> decodedCache; // keeps decoded tracks alive between loads
+    TrackSlot slots[2];
+    std::atomic<int> activeSlot{ 0 };
+    SourceStage sourceStage{ *this };
+    VarispeedSource varispeed{ &sourceStage };
+    TimeStretcher stretcher{ &varispeed };
+    ReleasePool releasePool;
+
+    LockFreeFifo<Command, 256> commandQueue;
+
+    // audio-thread-only state, changed exclusively by applyCommand()
+    bool sourceAttached = false;
+    bool running = false;
+    bool fadeIn = false;
+    bool fadeOut = false;
+    bool loopEnabled = false;
+    juce::int64 loopStart = 0;
+    juce::int64 loopEnd = 0;
+    std::shared_ptr<DecodedSegment> loopSegment;
+    bool playingFromLoop = false;
+    int loopPlayhead = 0;
+    bool wholeFileLooping = false;
+    std::array<std::shared_ptr<DecodedSegment>, numHotCues> hotCueSegments;
+    std::shared_ptr<DecodedSegment> cueSegment;   // playing from RAM until the transport takes over
+    int cuePlayhead = 0;
+
+    // what was about to play when a cue was triggered, faded out over the
+    // start of the cue; idle once jumpFadePosition reaches the length
+    juce::AudioBuffer<float> jumpFade;
+    int jumpFadeLength = 0;
+    int jumpFadePosition = 0;
+    int armedSlot = -1;
+    double speed = 1.0;
+    DeckEq eq;
+    GainRamp outputGain;
+    bool limiterRunning = false;   // false while the deck is silent
+    PeakLimiter limiter;
+    AudioTap outputTap;
+
+    // where the RAM loop or hot cue is playing, or -1 while the transport is
+    // in charge
+    std::atomic<juce::int64> loopPlayheadSample{ -1 };
+
+    // handshake used before the message thread reconfigures a transport
+    std::atomic<bool> prepared{ false };
+    std::atomic<int> preparedBlockSize{ 0 };
+    std::atomic<double> preparedSampleRate{ 0.0 };
+    std::atomic<juce::uint32> handshakeRequested{ 0 };
+    std::atomic<juce::uint32> handshakeAcknowledged{ 0 };
+
+    // bumped by the audio thread each time it hands over to the next track
+    std::atomic<juce::uint32> trackChanges{ 0 };
+
+    // shared between the message thread and the audio thread
+    std::atomic<bool> playing{ false };
+    std::atomic<bool> paused{ false };
+    std::atomic<bool> muted{ false };
+    std::atomic<float> currentGain{ 1.0f };
+    std::atomic<bool> normalising{ false };
+
+    // the library the loudness comes from, once normalisation has been on
+    std::unique_ptr<juce::SharedResourcePointer<LibraryIndex>> library;
 
-    bool paused = false;
-    bool muted = false;
-    float currentGain = 1.0f;
+    int readAheadSamples = 32768;
+    bool loopingEnabled = false;
+    bool keyLocked = false;
+    double targetLoudness = -14.0;
+    bool nextSlotArmed = false;
+    juce::uint32 nextGeneration = 0;
+    juce::uint32 handledTrackChanges = 0;
+    juce::int64 loopStartSample = 0;
+    juce::int64 loopEndSample = 0;
+    juce::uint32 loopGeneration = 0;
+    std::array<double, numHotCues> hotCueSeconds;
+    std::array<juce::uint32, numHotCues> hotCueGenerations{};
 
-    juce::String metadata;
+    static constexpr double maxLoopSecondsInRam = 120.0;
+    static constexpr double loopCrossfadeSeconds = 0.005;
+    static constexpr double hotCueSecondsInRam = 1.0;
+    static constexpr double nextTrackPrebufferSeconds = 4.0;
+    static constexpr double mappedPrefetchSeconds = 10.0;
+    static constexpr double unknownLoudness = -70.0;
+    static constexpr double maxNormalisationBoostDb = 12.0;
+    static constexpr double maxNormalisationCutDb = 24.0;
+    static constexpr float limiterCeilingDb = -1.0f;
+    static constexpr juce::uint32 commandRetryMilliseconds = 200;
+    juce::uint32 loadGeneration = 0;
 
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PlayerAudio)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlayerAudio)
 };
\ No newline at end of file
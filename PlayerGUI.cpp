@@ -3,16 +3,40 @@
 
 PlayerGUI::PlaylistComponent::PlaylistComponent()
 {
-    addAndMakeVisible(listBox);
-    listBox.setModel(this);
-    listBox.setRowHeight(24);
+    addAndMakeVisible(table);
+    table.setModel(this);
+    table.setRowHeight(24);
+
+    auto& header = table.getHeader();
+    header.addColumn("Title", (int)LibrarySearch::Column::title, 140, 40);
+    header.addColumn("Artist", (int)LibrarySearch::Column::artist, 100, 40);
+    header.addColumn("Time", (int)LibrarySearch::Column::duration, 48, 40);
+    header.addColumn("BPM", (int)LibrarySearch::Column::bpm, 44, 36);
+    header.addColumn("Path", (int)LibrarySearch::Column::path, 240, 60, -1,
+                     juce::TableHeaderComponent::defaultFlags & ~juce::TableHeaderComponent::visible);
+    header.setSortColumnId((int)LibrarySearch::Column::title, true);
+
+    addAndMakeVisible(searchBox);
+    searchBox.setTextToShowWhenEmpty("Search", juce::Colours::grey);
+    searchBox.onTextChange = [this] { refreshRows(); };
 
     addAndMakeVisible(addFilesButton);
     addFilesButton.setButtonText("Add Files");
     addFilesButton.addListener(this);
+
+    addAndMakeVisible(addFolderButton);
+    addFolderButton.setButtonText("Add Folder");
+    addFolderButton.addListener(this);
+
+    library->addChangeListener(this);
+    refreshRows();
+    rebuildSearchIndex();
 }
 
-PlayerGUI::PlaylistComponent::~PlaylistComponent() {}
+PlayerGUI::PlaylistComponent::~PlaylistComponent()
+{
+    library->removeChangeListener(this);
+}
 
 void PlayerGUI::PlaylistComponent::paint(juce::Graphics& g)
 {
@@ -25,28 +49,57 @@ void PlayerGUI::PlaylistComponent::paint(juce::Graphics& g)
 void PlayerGUI::PlaylistComponent::resized()
 {
     auto r = getLocalBounds().reduced(6);
-    addFilesButton.setBounds(r.removeFromBottom(28));
-    listBox.setBounds(r.removeFromTop(getHeight() - 40));
+    r.removeFromTop(20);
+    searchBox.setBounds(r.removeFromTop(24));
+    r.removeFromTop(4);
+
+    auto buttons = r.removeFromBottom(28);
+    addFilesButton.setBounds(buttons.removeFromLeft(buttons.getWidth() / 2));
+    addFolderButton.setBounds(buttons);
+    r.removeFromBottom(4);
+    table.setBounds(r);
 }
 
 int PlayerGUI::PlaylistComponent::getNumRows()
 {
-    return playlist.size();
+    return (int)rows.size();
 }
 
-void PlayerGUI::PlaylistComponent::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
+void PlayerGUI::PlaylistComponent::paintRowBackground(juce::Graphics& g, int, int, int, bool rowIsSelected)
 {
-    if (rowNumber < 0 || rowNumber >= playlist.size()) return;
     g.fillAll(rowIsSelected ? juce::Colours::lightblue : juce::Colours::transparentBlack);
+}
+
+void PlayerGUI::PlaylistComponent::paintCell(juce::Graphics& g, int rowNumber, int columnId, int width, int height, bool)
+{
+    // only called for visible rows, so strings are only ever built for those
+    if (rowNumber < 0 || rowNumber >= (int)rows.size()) return;
+    const auto track = library->getTrack(rows[(size_t)rowNumber]);
+
+    juce::String text;
+    switch ((LibrarySearch::Column)columnId)
+    {
+    case LibrarySearch::Column::title:    text = track.title; break;
+    case LibrarySearch::Column::artist:   text = track.artist; break;
+    case LibrarySearch::Column::duration:
+    {
+        const int secs = (int)track.lengthInSeconds;
+        text = juce::String(secs / 60) + ":" + juce::String(secs % 60).paddedLeft('0', 2);
+        break;
+    }
+    case LibrarySearch::Column::bpm:      text = track.bpm > 0.0 ? juce::String(track.bpm, 1) : juce::String(); break;
+    case LibrarySearch::Column::path:     text = track.path; break;
+    }
+
     g.setColour(juce::Colours::white);
-    g.drawText(playlist[rowNumber].getFileName(), 4, 0, width - 8, height, juce::Justification::centredLeft);
+    g.drawText(text, 4, 0, width - 8, height, juce::Justification::centredLeft);
 }
 
-void PlayerGUI::PlaylistComponent::listBoxItemDoubleClicked(int row, const juce::MouseEvent&)
+void PlayerGUI::PlaylistComponent::cellDoubleClicked(int row, int, const juce::MouseEvent&)
 {
-    if (row >= 0 && row < playlist.size())
+    if (row >= 0 && row < (int)rows.size())
     {
-        listBox.selectRow(row);
+        table.selectRow(row);
 
         auto selectedFile = getSelectedFile();
         if (selectedFile.existsAsFile())
@@ -56,32 +109,99 @@ void PlayerGUI::PlaylistComponent::listBoxItemDoubleClicked(int row, const juce:
     }
 }
 
-void PlayerGUI::PlaylistComponent::addFiles(const juce::Array<juce::File>& files)
+void PlayerGUI::PlaylistComponent::sortOrderChanged(int newSortColumnId, bool isForwards)
 {
-    for (const auto& f : files)
-        if (isAudioFile(f))
-            playlist.addIfNotAlreadyThere(f);
+    sortColumn = (LibrarySearch::Column)newSortColumnId;
+    sortAscending = isForwards;
+    refreshRows();
+}
 
-    listBox.updateContent();
+void PlayerGUI::PlaylistComponent::addFiles(const juce::Array<juce::File>& files)
+{
+    // probed in the background; the list refreshes from changeListenerCallback
+    library->addFiles(files);
 }
 
 juce::File PlayerGUI::PlaylistComponent::getFileAt(int index) const
 {
-    if (index >= 0 && index < playlist.size()) return playlist[index];
+    if (index >= 0 && index < (int)rows.size()) return library->getTrack(rows[(size_t)index]).getFile();
     return {};
 }
 
+juce::File PlayerGUI::PlaylistComponent::getFileAfter(const juce::File& file) const
+{
+    const int track = library->indexOf(file);
+    auto it = std::find(rows.begin(), rows.end(), track);
+
+    if (track < 0 || it == rows.end())
+        return {};
+
+    return getFileAt((int)(it - rows.begin()) + 1);
+}
+
 juce::File PlayerGUI::PlaylistComponent::getSelectedFile() const
 {
-    int r = listBox.getSelectedRow();
-    if (r >= 0 && r < playlist.size()) return playlist[r];
-    return {};
+    return getFileAt(table.getSelectedRow());
+}
+
+void PlayerGUI::PlaylistComponent::changeListenerCallback(juce::ChangeBroadcaster* source)
+{
+    // a big scan sends lots of these, so coalesce them into one rebuild
+    if (source == library.get())
+        startTimer(300);
+}
+
+void PlayerGUI::PlaylistComponent::timerCallback()
+{
+    stopTimer();
+    rebuildSearchIndex();
+}
+
+void PlayerGUI::PlaylistComponent::rebuildSearchIndex()
+{
+    const auto generation = ++searchGeneration;
+    juce::Component::SafePointer<PlaylistComponent> safeThis(this);
+
+    juce::Thread::launch([safeThis, generation, snapshot = library->getSnapshot()]
+    {
+        auto index = LibrarySearch::build(snapshot);
+
+        juce::MessageManager::callAsync([safeThis, generation, index]
+        {
+            if (safeThis == nullptr || generation != safeThis->searchGeneration)
+                return;
+
+            safeThis->searchIndex = index;
+            safeThis->refreshRows();
+        });
+    });
 }
 
-bool PlayerGUI::PlaylistComponent::isAudioFile(const juce::File& f) const
+void PlayerGUI::PlaylistComponent::refreshRows()
 {
-    auto ext = f.getFileExtension().toLowerCase();
-    return ext == ".wav" || ext == ".mp3" || ext == ".aiff" || ext == ".flac" || ext == ".ogg" || ext == ".m4a";
+    const auto selectedTrack = table.getSelectedRow() >= 0 && table.getSelectedRow() < (int)rows.size()
+        ? rows[(size_t)table.getSelectedRow()] : -1;
+
+    if (searchIndex != nullptr)
+    {
+        rows = searchIndex->query(searchBox.getText(), sortColumn, sortAscending);
+    }
+    else
+    {
+        // until the first index is ready, show the library in the order it was added
+        rows.resize((size_t)library->getNumTracks());
+        std::iota(rows.begin(), rows.end(), 0);
+    }
+
+    table.updateContent();
+
+    auto found = std::find(rows.begin(), rows.end(), selectedTrack);
+    if (found != rows.end())
+        table.selectRow((int)(found - rows.begin()));
+    else
+        table.deselectAllRows();
+
+    table.repaint();
 }
 
 void PlayerGUI::PlaylistComponent::buttonClicked(juce::Button* b)
@@ -95,6 +215,17 @@ void PlayerGUI::PlaylistComponent::buttonClicked(juce::Button* b)
                 addFiles(fc.getResults());
             });
     }
+    else if (b == &addFolderButton)
+    {
+        auto chooser = std::make_shared<juce::FileChooser>("Select a music folder...");
+        chooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectDirectories,
+            [this, chooser](const juce::FileChooser& fc)
+            {
+                auto folder = fc.getResult();
+                if (folder.isDirectory())
+                    library->scanDirectory(folder);
+            });
+    }
 }
 
 
@@ -140,6 +271,62 @@ PlayerGUI::PlayerGUI(PlayerAudio& audioEngineRef, PlaylistComponent* sharedPlayl
     addAndMakeVisible(loopButton);
     loopButton.addListener(this);
 
+    addAndMakeVisible(keyLockButton);
+    keyLockButton.addListener(this);
+
+    addAndMakeVisible(normaliseButton);
+    normaliseButton.addListener(this);
+
+    // kill EQ knobs and the filter; double-click puts any of them back to flat
+    for (auto* knob : { &eqLowSlider, &eqMidSlider, &eqHighSlider, &filterSlider })
+    {
+        addAndMakeVisible(knob);
+        knob->setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
+        knob->setTextBoxStyle(juce::Slider::TextBoxBelow, false, 56, 16);
+        knob->setDoubleClickReturnValue(true, 0.0);
+        knob->addListener(this);
+    }
+
+    for (auto* band : { &eqLowSlider, &eqMidSlider, &eqHighSlider })
+    {
+        band->setRange(DeckEq::killDecibels, DeckEq::maxBoostDecibels, 0.1);
+        band->setSkewFactorFromMidPoint(-6.0);
+        band->setTextValueSuffix(" dB");
+        band->setValue(0.0, juce::dontSendNotification);
+    }
+
+    juce::Slider* knobs[] = { &eqLowSlider, &eqMidSlider, &eqHighSlider, &filterSlider };
+    const char* knobNames[] = { "Low", "Mid", "High", "Filter" };
+
+    for (size_t i = 0; i < knobLabels.size(); ++i)
+    {
+        knobLabels[i].setText(knobNames[i], juce::dontSendNotification);
+        knobLabels[i].setJustificationType(juce::Justification::centred);
+        knobLabels[i].attachToComponent(knobs[i], false);
+    }
+
+    eqLowSlider.setTooltip("Low shelf, 250 Hz");
+    eqMidSlider.setTooltip("Mid peak, 1 kHz");
+    eqHighSlider.setTooltip("High shelf, 4 kHz");
+    filterSlider.setTooltip("Filter: low-pass to the left, high-pass to the right");
+    filterSlider.setRange(-1.0, 1.0, 0.01);
+    filterSlider.setValue(0.0, juce::dontSendNotification);
+
+    for (int i = 0; i < PlayerAudio::numHotCues; ++i)
+    {
+        addAndMakeVisible(hotCueButtons[(size_t)i]);
+        hotCueButtons[(size_t)i].setButtonText(juce::String(i + 1));
+        hotCueButtons[(size_t)i].addListener(this);
+    }
+
+    addAndMakeVisible(hotCueHint);
+    hotCueHint.setText("shift-click clears", juce::dontSendNotification);
+    hotCueHint.setFont(juce::Font(11.0f));
+    hotCueHint.setColour(juce::Label::textColourId, juce::Colours::lightgrey);
+
+    addAndMakeVisible(outputDisplay);
+    addAndMakeVisible(waveformView);
+
     addAndMakeVisible(titleLabel);
     titleLabel.setJustificationType(juce::Justification::centredLeft);
     titleLabel.setText("No file", juce::dontSendNotification);
@@ -156,19 +343,18 @@ PlayerGUI::PlayerGUI(PlayerAudio& audioEngineRef, PlaylistComponent* sharedPlayl
     positionLabel.setText("0:00 / 0:00", juce::dontSendNotification);
     positionLabel.setJustificationType(juce::Justification::centred);
 
-    
-    startTimerHz(20); 
+    // the waveform view animates its own playhead; this only keeps the
+    // labels and buttons up to date
+    startTimerHz(20);
 
-   
-    thumbnail = std::make_unique<juce::AudioThumbnail>(512, audioEngine.getFormatManager(), thumbnailCache);
-
-    startTimerHz(30);
+    audioEngine.onTrackChanged = [this] { trackStarted(); };
 
     setSize(320, 260);
 }
 
 PlayerGUI::~PlayerGUI()
 {
+    audioEngine.onTrackChanged = nullptr;
     stopTimer();
 }
 
@@ -176,25 +362,11 @@ void PlayerGUI::paint(juce::Graphics& g)
 {
     g.fillAll(juce::Colours::darkslategrey);
 
-    if (fileLoaded && thumbnail)
-    {
-        auto warea = getLocalBounds().reduced(10).removeFromBottom(110);
-        thumbnail->drawChannels(g, warea.reduced(2), 0.0, thumbnail->getTotalLength(), 1.0f);
-
-        // draw playhead
-        if (thumbnail->getTotalLength() > 0.0)
-        {
-            double pos = audioEngine.getCurrentPosition();
-            double len = thumbnail->getTotalLength();
-            float x = (float)juce::jmap(pos, 0.0, len, (double)warea.getX(), (double)warea.getRight());
-            g.setColour(juce::Colours::red);
-            g.drawLine(x, (float)warea.getY(), x, (float)warea.getBottom(), 2.0f);
-        }
-    }
-    else
+    if (!fileLoaded || !waveform)
     {
         g.setColour(juce::Colours::white);
-        g.drawFittedText("No audio loaded", getLocalBounds().reduced(10), juce::Justification::centred, 1);
+        g.drawFittedText(fileLoaded ? "Building waveform..." : "No audio loaded",
+                         getLocalBounds().reduced(10), juce::Justification::centred, 1);
     }
 }
 
@@ -215,14 +387,34 @@ void PlayerGUI::resized()
     setBButton.setBounds(row2.removeFromLeft(60));
     abLoopToggle.setBounds(row2.removeFromLeft(100));
     muteButton.setBounds(row2.removeFromLeft(60));
+    keyLockButton.setBounds(row2.removeFromLeft(90));
+    normaliseButton.setBounds(row2.removeFromLeft(90));
 
     auto sliders = r.removeFromTop(50);
     volumeSlider.setBounds(sliders.removeFromLeft(getWidth() / 2 - 12));
     speedSlider.setBounds(sliders);
 
+    // the labels sit above the knobs, in the top of this row
+    auto knobs = r.removeFromTop(82).withTrimmedTop(18);
+    const int knobWidth = juce::jmin(70, knobs.getWidth() / 4);
+    eqLowSlider.setBounds(knobs.removeFromLeft(knobWidth));
+    eqMidSlider.setBounds(knobs.removeFromLeft(knobWidth));
+    eqHighSlider.setBounds(knobs.removeFromLeft(knobWidth));
+    filterSlider.setBounds(knobs.removeFromLeft(knobWidth));
+
+    auto cues = r.removeFromTop(28);
+    const int cueWidth = juce::jmin(40, cues.getWidth() / PlayerAudio::numHotCues);
+    for (auto& cue : hotCueButtons)
+        cue.setBounds(cues.removeFromLeft(cueWidth).reduced(2, 2));
+    hotCueHint.setBounds(cues);
+
+    outputDisplay.setBounds(r.removeFromTop(56).reduced(0, 4));
+
     auto bottomArea = getLocalBounds().removeFromBottom(40);
     positionSlider.setBounds(bottomArea.removeFromLeft(getWidth() * 0.8));
     positionLabel.setBounds(bottomArea);
+
+    waveformView.setBounds(getLocalBounds().reduced(10).removeFromBottom(110).reduced(2));
    
 }
 
@@ -241,21 +433,20 @@ void PlayerGUI::buttonClicked(juce::Button* b)
                 [this](const juce::FileChooser& fc)
                 {
                     auto file = fc.getResult();
-                    if (file.existsAsFile())
-                    {
-                        audioEngine.loadFile(file);
-                        thumbnail->setSource(new juce::FileInputSource(file));
-                        fileLoaded = true;
-                        titleLabel.setText(file.getFileNameWithoutExtension(), juce::dontSendNotification);
-                    }
+                    if (!file.existsAsFile())
+                        return;
+
+                    // into the library too, so it gets analysed for tempo,
+                    // key and loudness like everything else
+                    if (playlistComponent != nullptr)
+                        playlistComponent->getLibrary().addFiles(juce::Array<juce::File>{ file });
+
+                    loadTrack(file);
                 });
         }
         else
         {
-            audioEngine.loadFile(toLoad);
-            thumbnail->setSource(new juce::FileInputSource(toLoad));
-            fileLoaded = true;
-            titleLabel.setText(toLoad.getFileNameWithoutExtension(), juce::dontSendNotification);
+            loadTrack(toLoad);
         }
     }
     else if (b == &playPauseButton)
@@ -298,6 +489,20 @@ void PlayerGUI::buttonClicked(juce::Button* b)
     {
         audioEngine.setLooping(loopButton.getToggleState());
     }
+    else if (b == &keyLockButton)
+    {
+        audioEngine.setKeyLock(keyLockButton.getToggleState());
+    }
+    else if (b == &normaliseButton)
+    {
+        audioEngine.setLoudnessNormalisation(normaliseButton.getToggleState());
+    }
+    else
+    {
+        for (int i = 0; i < PlayerAudio::numHotCues; ++i)
+            if (b == &hotCueButtons[(size_t)i])
+                hotCueClicked(i);
+    }
 }
 
 void PlayerGUI::sliderValueChanged(juce::Slider* s)
@@ -311,6 +516,22 @@ void PlayerGUI::sliderValueChanged(juce::Slider* s)
     {
         audioEngine.setSpeed(speedSlider.getValue());
     }
+    else if (s == &eqLowSlider)
+    {
+        audioEngine.setEqGain(DeckEq::Band::low, (float)eqLowSlider.getValue());
+    }
+    else if (s == &eqMidSlider)
+    {
+        audioEngine.setEqGain(DeckEq::Band::mid, (float)eqMidSlider.getValue());
+    }
+    else if (s == &eqHighSlider)
+    {
+        audioEngine.setEqGain(DeckEq::Band::high, (float)eqHighSlider.getValue());
+    }
+    else if (s == &filterSlider)
+    {
+        audioEngine.setFilter((float)filterSlider.getValue());
+    }
     else if (s == &positionSlider)
     {
         double len = audioEngine.getTotalLength();
@@ -334,6 +555,128 @@ void PlayerGUI::updatePlayPauseText()
         playPauseButton.setButtonText("Play");
 }
 
+void PlayerGUI::loadTrack(const juce::File& file)
+{
+    titleLabel.setText("Loading " + file.getFileName() + "...", juce::dontSendNotification);
+
+    juce::Component::SafePointer<PlayerGUI> safeThis(this);
+    audioEngine.loadFileAsync(file, [safeThis, file](bool ok)
+        {
+            if (safeThis == nullptr)
+                return;
+
+            if (!ok)
+            {
+                safeThis->titleLabel.setText("Couldn't open " + file.getFileName(), juce::dontSendNotification);
+                return;
+            }
+
+            safeThis->trackStarted();
+        });
+}
+
+void PlayerGUI::trackStarted()
+{
+    const auto file = audioEngine.getCurrentFile();
+
+    waveform = nullptr;
+    waveformView.setOverview(nullptr);
+    fileLoaded = true;
+    loopStart = loopEnd = 0.0;
+    enableABLoop(false);
+    juce::String title = file.getFileNameWithoutExtension();
+
+    // the library has usually analysed the track long before it gets here
+    if (playlistComponent != nullptr)
+    {
+        auto& library = playlistComponent->getLibrary();
+        const auto track = library.getTrack(library.indexOf(file));
+
+        if (track.analysed)
+        {
+            if (track.bpm > 0.0)
+                title << "  " << juce::String(track.bpm, 1) << " BPM";
+            if (track.key.isNotEmpty())
+                title << "  " << track.key;
+            title << "  " << juce::String(track.loudness, 1) << " LUFS";
+        }
+
+        // handing the cues over has the player decode their audio now
+        for (int i = 0; i < PlayerAudio::numHotCues; ++i)
+            if (track.hotCues[(size_t)i] >= 0.0)
+                audioEngine.setHotCue(i, track.hotCues[(size_t)i]);
+    }
+
+    updateHotCueButtons();
+
+    titleLabel.setText(title, juce::dontSendNotification);
+    updatePlayPauseText();
+    repaint();
+
+    juce::Component::SafePointer<PlayerGUI> safeThis(this);
+    waveformCache->getOverview(file, audioEngine.getFormatManager(),
+        [safeThis, file](WaveformCache::OverviewPtr overview)
+        {
+            if (safeThis == nullptr || safeThis->audioEngine.getCurrentFile() != file)
+                return;
+
+            safeThis->waveform = overview;
+            safeThis->waveformView.setOverview(overview);
+            safeThis->repaint();
+        });
+
+    // queue whatever follows in the playlist so the deck carries on gaplessly
+    if (playlistComponent != nullptr)
+        audioEngine.setNextFile(playlistComponent->getFileAfter(file));
+}
+
+void PlayerGUI::hotCueClicked(int index)
+{
+    if (!fileLoaded)
+        return;
+
+    const bool clearing = juce::ModifierKeys::currentModifiers.isShiftDown();
+    const bool isSet = audioEngine.getHotCue(index) >= 0.0;
+
+    if (isSet && !clearing)
+    {
+        audioEngine.triggerHotCue(index);
+        updatePlayPauseText();
+        return;
+    }
+
+    if (!isSet && clearing)
+        return;
+
+    const double seconds = clearing ? -1.0 : audioEngine.getCurrentPosition();
+    audioEngine.setHotCue(index, seconds);
+
+    if (playlistComponent != nullptr)
+        playlistComponent->getLibrary().setHotCue(audioEngine.getCurrentFile(), index, seconds);
+
+    updateHotCueButtons();
+}
+
+void PlayerGUI::updateHotCueButtons()
+{
+    for (int i = 0; i < PlayerAudio::numHotCues; ++i)
+    {
+        auto& button = hotCueButtons[(size_t)i];
+        const double seconds = audioEngine.getHotCue(i);
+
+        if (seconds >= 0.0)
+        {
+            button.setColour(juce::TextButton::buttonColourId, juce::Colours::darkorange);
+            button.setTooltip("Cue " + juce::String(i + 1) + " at " + formatTime(seconds) + "; shift-click to clear");
+        }
+        else
+        {
+            button.removeColour(juce::TextButton::buttonColourId);
+            button.setTooltip("Set cue " + juce::String(i + 1) + " at the playhead");
+        }
+    }
+}
+
 juce::String PlayerGUI::formatTime(double s)
 {
     int secs = (int)std::round(s);
@@ -345,22 +688,34 @@ juce::String PlayerGUI::formatTime(double s)
 void PlayerGUI::setABLoopStart()
 {
     loopStart = audioEngine.getCurrentPosition();
+    if (loopEnd > loopStart)
+        audioEngine.setLoopPoints(loopStart, loopEnd);
 }
 
 void PlayerGUI::setABLoopEnd()
 {
     loopEnd = audioEngine.getCurrentPosition();
+    if (loopEnd > loopStart)
+        audioEngine.setLoopPoints(loopStart, loopEnd);
 }
 
 void PlayerGUI::enableABLoop(bool enable)
 {
-    isABLooping = enable;
+    isABLooping = enable && loopEnd > loopStart;
+    audioEngine.setLoopEnabled(isABLooping);
+
     if (isABLooping)
         audioEngine.setPosition(loopStart);
+    else
+        abLoopToggle.setToggleState(false, juce::dontSendNotification);
 }
 
 void PlayerGUI::timerCallback()
 {
+    // transport changes are applied asynchronously by the audio thread, and
+    // it also stops on its own at the end of the file
+    updatePlayPauseText();
+
     if (audioEngine.getTotalLength() > 0)
     {
         double pos = audioEngine.getCurrentPosition();
@@ -1,6 +1,11 @@
 #pragma once
 #include <JuceHeader.h>
 #include "PlayerAudio.h"
+#include "TapDisplay.h"
+#include "WaveformView.h"
+#include "WaveformCache.h"
+#include "LibraryIndex.h"
+#include "LibrarySearch.h"
 
 class PlayerGUI : public juce::Component,
     public juce::Button::Listener,
@@ -9,8 +14,10 @@ class PlayerGUI : public juce::Component,
 {
 public:
     class PlaylistComponent : public juce::Component,
-        public juce::ListBoxModel,
-        public juce::Button::Listener
+        public juce::TableListBoxModel,
+        public juce::Button::Listener,
+        public juce::ChangeListener,
+        private juce::Timer
     {
     public:
         PlaylistComponent();
@@ -21,24 +28,43 @@ public:
 
        
         int getNumRows() override;
-        void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
-        void listBoxItemDoubleClicked(int row, const juce::MouseEvent&) override;
+        void paintRowBackground(juce::Graphics& g, int rowNumber, int width, int height, bool rowIsSelected) override;
+        void paintCell(juce::Graphics& g, int rowNumber, int columnId, int width, int height, bool rowIsSelected) override;
+        void cellDoubleClicked(int row, int columnId, const juce::MouseEvent&) override;
+        void sortOrderChanged(int newSortColumnId, bool isForwards) override;
         void buttonClicked(juce::Button* b)override;
+        void changeListenerCallback(juce::ChangeBroadcaster* source) override;
 
        
         void addFiles(const juce::Array<juce::File>& files);
+
+        // rows are positions in the current filtered, sorted view
         juce::File getFileAt(int index) const;
-        int getNumFiles() const { return playlist.size(); }
+        juce::File getFileAfter(const juce::File& file) const;
+        int getNumFiles() const { return (int)rows.size(); }
+        LibraryIndex& getLibrary() { return library.getObject(); }
 
         
         juce::File getSelectedFile() const;
 
     private:
-        juce::ListBox listBox;
-        juce::Array<juce::File> playlist;
+        void timerCallback() override;
+        void rebuildSearchIndex();
+        void refreshRows();
+
+        juce::TableListBox table;
+        juce::TextEditor searchBox;
+        juce::SharedResourcePointer<LibraryIndex> library;
         juce::TextButton addFilesButton;
+        juce::TextButton addFolderButton;
+
+        // track indices shown in the table, in display order
+        std::vector<int> rows;
+        std::shared_ptr<const LibrarySearch> searchIndex;
+        juce::uint32 searchGeneration = 0;
+        LibrarySearch::Column sortColumn = LibrarySearch::Column::title;
+        bool sortAscending = true;
 
-        bool isAudioFile(const juce::File& f) const;
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PlaylistComponent)
     };
 
@@ -77,8 +103,22 @@ private:
     juce::Slider speedSlider;
     juce::ToggleButton muteButton{ "Mute" };
     juce::ToggleButton loopButton{ "Loop" };
-    juce::AudioThumbnailCache thumbnailCache{ 5 };
-    std::unique_ptr<juce::AudioThumbnail> thumbnail;
+    juce::ToggleButton keyLockButton{ "Key Lock" };
+    juce::ToggleButton normaliseButton{ "Normalise" };
+    juce::Slider eqLowSlider;
+    juce::Slider eqMidSlider;
+    juce::Slider eqHighSlider;
+    juce::Slider filterSlider;
+    std::array<juce::Label, 4> knobLabels;
+
+    // click an empty pad to set a cue at the playhead, a set one to jump to
+    // it; shift-click clears
+    std::array<juce::TextButton, PlayerAudio::numHotCues> hotCueButtons;
+    juce::Label hotCueHint;
+    TapDisplay outputDisplay{ audioEngine.getOutputTap() };
+    WaveformView waveformView{ audioEngine };
+    juce::SharedResourcePointer<WaveformCache> waveformCache;
+    WaveformCache::OverviewPtr waveform;
     juce::Label titleLabel;
 
    
@@ -92,6 +132,10 @@ private:
 
     
     void updatePlayPauseText();
+    void loadTrack(const juce::File& file);
+    void trackStarted();
+    void hotCueClicked(int index);
+    void updateHotCueButtons();
     juce::String formatTime(double s);
     juce::Slider positionSlider;
     juce::Label positionLabel;
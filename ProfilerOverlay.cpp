@@ -0,0 +1,81 @@
+#include "ProfilerOverlay.h"
+#include "AppData.h"
+
+ProfilerOverlay::ProfilerOverlay()
+{
+    addAndMakeVisible(resetButton);
+    resetButton.onClick = [this]
+    {
+        AudioProfiler::getInstance().reset();
+        status.clear();
+        repaint();
+    };
+
+    addAndMakeVisible(saveButton);
+    saveButton.onClick = [this] { saveReport(); };
+
+    setInterceptsMouseClicks(false, true);
+}
+
+ProfilerOverlay::~ProfilerOverlay()
+{
+    stopTimer();
+    AudioProfiler::getInstance().setEnabled(false);
+}
+
+void ProfilerOverlay::visibilityChanged()
+{
+    const bool visible = isVisible();
+    AudioProfiler::getInstance().setEnabled(visible);
+
+    if (visible)
+        startTimerHz(4);
+    else
+        stopTimer();
+}
+
+void ProfilerOverlay::timerCallback()
+{
+    AudioProfiler::getInstance().update();
+    repaint();
+}
+
+void ProfilerOverlay::paint(juce::Graphics& g)
+{
+    g.setColour(juce::Colours::black.withAlpha(0.8f));
+    g.fillRoundedRectangle(getLocalBounds().toFloat(), 6.0f);
+
+    auto area = getLocalBounds().reduced(8);
+    area.removeFromBottom(30);
+
+    g.setColour(juce::Colours::lightgreen);
+    g.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 12.0f, juce::Font::plain));
+
+    auto lines = juce::StringArray::fromLines(AudioProfiler::getInstance().createReport());
+    if (status.isNotEmpty())
+        lines.add(status);
+
+    for (auto& line : lines)
+        g.drawSingleLineText(line, area.getX(), area.removeFromTop(15).getBottom() - 3);
+}
+
+void ProfilerOverlay::resized()
+{
+    auto buttons = getLocalBounds().reduced(8).removeFromBottom(24);
+    resetButton.setBounds(buttons.removeFromLeft(70));
+    buttons.removeFromLeft(6);
+    saveButton.setBounds(buttons.removeFromLeft(100));
+}
+
+void ProfilerOverlay::saveReport()
+{
+    auto directory = getAppDataDirectory();
+    directory.createDirectory();
+
+    auto file = directory.getNonexistentChildFile("profile-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S"),
+                                                  ".txt", false);
+
+    status = AudioProfiler::getInstance().dumpToFile(file) ? "Saved " + file.getFullPathName()
+                                                           : "Couldn't write " + file.getFullPathName();
+    repaint();
+}
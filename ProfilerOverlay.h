@@ -0,0 +1,27 @@
+#pragma once
+#include <JuceHeader.h>
+#include "AudioProfiler.h"
+
+// Debug overlay showing the AudioProfiler's per-stage percentiles and
+// deadline counters. Profiling runs while the overlay is visible.
+class ProfilerOverlay : public juce::Component,
+    private juce::Timer
+{
+public:
+    ProfilerOverlay();
+    ~ProfilerOverlay() override;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+    void visibilityChanged() override;
+
+private:
+    void timerCallback() override;
+    void saveReport();
+
+    juce::TextButton resetButton{ "Reset" };
+    juce::TextButton saveButton{ "Save Report" };
+    juce::String status;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProfilerOverlay)
+};
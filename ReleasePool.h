@@ -0,0 +1,32 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Keeps objects that have been handed to the audio thread alive until the
+// audio thread has let go of them, then frees them on the message thread.
+// The audio thread only ever copies, moves or drops std::shared_ptrs to
+// pooled objects, so it never ends up running a destructor itself.
+// add() must be called on the message thread.
+class ReleasePool : private juce::Timer
+{
+public:
+    ReleasePool() { startTimer(1000); }
+
+    template <typename ObjectType>
+    void add(const std::shared_ptr<ObjectType>& object)
+    {
+        if (object != nullptr)
+            pool.emplace_back(object);
+    }
+
+private:
+    void timerCallback() override
+    {
+        pool.erase(std::remove_if(pool.begin(), pool.end(),
+                                  [](const std::shared_ptr<void>& object) { return object.use_count() <= 1; }),
+                   pool.end());
+    }
+
+    std::vector<std::shared_ptr<void>> pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ReleasePool)
+};
@@ -0,0 +1,298 @@
+// Headless renderer: mixes a playlist to a WAV or FLAC file as fast as the
+// CPU allows, with no audio device and no GUI. It drives the same PlayerAudio
+// and DeckMixer as the app, two decks alternating with a crossfade between
+// consecutive tracks, and hands the mix to a writer thread so decoding and
+// encoding overlap.
+//
+// Build this file as a console target, together with the engine sources and
+// without Main.cpp, with UNIFIED_AUDIO_RENDER=1 defined. It has its own
+// main(), so without that flag it compiles to nothing and can sit in the
+// app's project alongside everything else.
+//
+//   UnifiedAudioRender [options] <file|playlist.m3u>...
+//     --out, -o <file>       output file; .flac for FLAC, anything else is WAV (mix.wav)
+//     --rate <hz>            output sample rate (44100)
+//     --bits <n>             bits per sample (24)
+//     --block <n>            samples rendered per block (512)
+//     --crossfade <seconds>  overlap between consecutive tracks (0)
+#if UNIFIED_AUDIO_RENDER
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "PlayerAudio.h"
+#include "DeckMixer.h"
+#include "Crossfader.h"
+
+namespace
+{
+    juce::Array<juce::File> expandPlaylist(const juce::StringArray& paths)
+    {
+        juce::Array<juce::File> files;
+
+        for (auto& path : paths)
+        {
+            auto file = juce::File::getCurrentWorkingDirectory().getChildFile(path);
+
+            if (file.hasFileExtension(".m3u;.m3u8"))
+            {
+                juce::StringArray lines;
+                file.readLines(lines);
+
+                for (auto& line : lines)
+                    if (line.trim().isNotEmpty() && !line.startsWith("#"))
+                        files.add(file.getParentDirectory().getChildFile(line.trim()));
+            }
+            else
+            {
+                files.add(file);
+            }
+        }
+
+        return files;
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> createWriter(const juce::File& outputFile, double sampleRate,
+                                                          int numChannels, int bitsPerSample)
+    {
+        std::unique_ptr<juce::AudioFormat> format;
+        if (outputFile.hasFileExtension(".flac"))
+            format = std::make_unique<juce::FlacAudioFormat>();
+        else
+            format = std::make_unique<juce::WavAudioFormat>();
+
+        outputFile.deleteFile();
+        auto stream = std::make_unique<juce::FileOutputStream>(outputFile);
+        if (stream->failedToOpen())
+            return nullptr;
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), sampleRate,
+                                                                                (unsigned int)numChannels,
+                                                                                bitsPerSample, {}, 0));
+        if (writer != nullptr)
+            stream.release(); // the writer owns it now
+
+        return writer;
+    }
+
+    // Alternates two players, starting the next track on the idle deck when
+    // the current one is crossfadeSeconds from its end.
+    class OfflineSession
+    {
+    public:
+        OfflineSession(juce::AudioFormatManager& fm, const juce::Array<juce::File>& tracksToPlay,
+                       double rate, int block, double crossfade)
+            : tracks(tracksToPlay), sampleRate(rate), blockSize(block), crossfadeSeconds(crossfade),
+              mixer(DeckMixer::getDefaultNumWorkers())
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                auto* player = players.add(new PlayerAudio(fm));
+
+                // decode on the render thread: there's no deadline to protect,
+                // and it keeps the output deterministic
+                player->setReadAheadBufferSize(0);
+                mixer.addDeck(player, 0.0f);
+            }
+
+            mixer.prepareToPlay(blockSize, sampleRate);
+        }
+
+        ~OfflineSession()
+        {
+            mixer.releaseResources();
+        }
+
+        bool start() { return startTrack(0); }
+
+        // Renders the next block; returns false if the last track ended in it.
+        bool renderBlock(juce::AudioBuffer<float>& buffer)
+        {
+            auto& current = *players[currentDeck];
+
+            if (fadeSamplesDone < 0 && hasMoreTracks())
+            {
+                const double remaining = current.getTotalLength() - current.getCurrentPosition();
+                if (remaining <= crossfadeSeconds || !current.isPlaying())
+                    if (startTrack(currentTrack + 1))
+                        fadeSamplesDone = 0;
+            }
+
+            if (fadeSamplesDone >= 0)
+            {
+                // The app crossfader's default law. Each block fades to where
+                // the fade stands at its end, so the last one leaves the new
+                // deck at unity; with no crossfade that's the very first block.
+                const int fadeLength = juce::jmax(1, juce::roundToInt(crossfadeSeconds * sampleRate));
+                fadeSamplesDone = juce::jmin(fadeLength, fadeSamplesDone + blockSize);
+
+                const float position = (float)fadeSamplesDone / (float)fadeLength;
+                float previousGain = 0.0f, currentGain = 1.0f;
+                crossfader.getGains(position, previousGain, currentGain);
+                mixer.setDeckGain(previousDeck, previousGain);
+                mixer.setDeckGain(currentDeck, currentGain);
+
+                if (fadeSamplesDone == fadeLength)
+                {
+                    players[previousDeck]->stop();
+                    mixer.setDeckGain(previousDeck, 0.0f);
+                    fadeSamplesDone = -1;
+                }
+            }
+
+            mixer.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, blockSize));
+
+            return players[currentDeck]->isPlaying() || hasMoreTracks() || fadeSamplesDone >= 0;
+        }
+
+        int getCurrentTrack() const { return currentTrack; }
+
+    private:
+        bool hasMoreTracks() const { return !exhausted && currentTrack + 1 < tracks.size(); }
+
+        bool startTrack(int index)
+        {
+            for (; index < tracks.size(); ++index)
+            {
+                const int deck = index == 0 ? 0 : 1 - currentDeck;
+                auto& player = *players[deck];
+
+                // a released player has no audio thread to hand the old source
+                // back, so loading into it doesn't wait on one
+                player.releaseResources();
+                player.loadFile(tracks[index]);
+                player.prepareToPlay(blockSize, sampleRate);
+
+                if (player.getCurrentFile() != tracks[index])
+                {
+                    std::cerr << "Skipping unreadable file: " << tracks[index].getFullPathName() << std::endl;
+                    continue;
+                }
+
+                player.play();
+                previousDeck = currentDeck;
+                currentDeck = deck;
+                currentTrack = index;
+
+                if (index == 0)
+                    mixer.setDeckGain(deck, 1.0f);
+
+                std::cout << "[" << (index + 1) << "/" << tracks.size() << "] "
+                          << tracks[index].getFileName() << std::endl;
+                return true;
+            }
+
+            exhausted = true;
+            return false;
+        }
+
+        const juce::Array<juce::File> tracks;
+        const double sampleRate;
+        const int blockSize;
+        const double crossfadeSeconds;
+
+        juce::OwnedArray<PlayerAudio> players;
+        DeckMixer mixer;
+        Crossfader crossfader;
+
+        int currentTrack = -1;
+        int currentDeck = 0;
+        int previousDeck = 1;
+        int fadeSamplesDone = -1;
+        bool exhausted = false;
+    };
+}
+
+int main(int argc, char* argv[])
+{
+    // PlayerAudio's timers and message-thread helpers need a MessageManager,
+    // though nothing here runs its loop
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::ArgumentList args(argc, argv);
+
+    if (args.size() == 0 || args.containsOption("--help|-h"))
+    {
+        std::cout << "usage: " << args.executableName << " [--out mix.wav] [--rate 44100] [--bits 24]"
+                  << " [--block 512] [--crossfade 0] <file|playlist.m3u>..." << std::endl;
+        return 0;
+    }
+
+    const auto outputPath = args.removeValueForOption("--out|-o");
+    const auto rateText = args.removeValueForOption("--rate");
+    const auto bitsText = args.removeValueForOption("--bits");
+    const auto blockText = args.removeValueForOption("--block");
+    const auto crossfadeText = args.removeValueForOption("--crossfade");
+
+    const auto outputFile = juce::File::getCurrentWorkingDirectory().getChildFile(outputPath.isNotEmpty() ? outputPath : "mix.wav");
+    const double sampleRate = rateText.isNotEmpty() ? rateText.getDoubleValue() : 44100.0;
+    const int bitsPerSample = bitsText.isNotEmpty() ? bitsText.getIntValue() : 24;
+    const int blockSize = juce::jlimit(16, 8192, blockText.isNotEmpty() ? blockText.getIntValue() : 512);
+    const double crossfadeSeconds = juce::jmax(0.0, crossfadeText.getDoubleValue());
+
+    juce::StringArray paths;
+    for (auto& arg : args.arguments)
+        if (!arg.isOption())
+            paths.add(arg.text);
+
+    const auto tracks = expandPlaylist(paths);
+    if (tracks.isEmpty())
+    {
+        std::cerr << "No input files" << std::endl;
+        return 1;
+    }
+
+    constexpr int numChannels = 2;
+    auto writer = createWriter(outputFile, sampleRate, numChannels, bitsPerSample);
+    if (writer == nullptr)
+    {
+        std::cerr << "Couldn't create " << outputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    juce::TimeSliceThread writerThread("Render Writer");
+    writerThread.startThread();
+
+    // the FIFO holds a few seconds, so a slow encoder block doesn't stall
+    // decoding and vice versa
+    auto threadedWriter = std::make_unique<juce::AudioFormatWriter::ThreadedWriter>(writer.release(), writerThread,
+                                                                                   (int)(sampleRate * 4));
+
+    OfflineSession session(formatManager, tracks, sampleRate, blockSize, crossfadeSeconds);
+    if (!session.start())
+    {
+        std::cerr << "None of the input files could be read" << std::endl;
+        return 1;
+    }
+
+    juce::AudioBuffer<float> buffer(numChannels, blockSize);
+    juce::int64 samplesRendered = 0;
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    for (bool more = true; more;)
+    {
+        more = session.renderBlock(buffer);
+
+        while (!threadedWriter->write(buffer.getArrayOfReadPointers(), blockSize))
+            juce::Thread::sleep(1); // the writer is behind; let it drain
+
+        samplesRendered += blockSize;
+    }
+
+    // flushes the FIFO and closes the file
+    threadedWriter.reset();
+    writerThread.stopThread(4000);
+
+    const double renderedSeconds = (double)samplesRendered / sampleRate;
+    const double elapsedSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+
+    std::cout << "Wrote " << juce::String(renderedSeconds, 1) << "s to " << outputFile.getFullPathName()
+              << " in " << juce::String(elapsedSeconds, 1) << "s ("
+              << juce::String(renderedSeconds / juce::jmax(0.001, elapsedSeconds), 1) << "x realtime)" << std::endl;
+
+    return 0;
+}
+
+#endif // UNIFIED_AUDIO_RENDER
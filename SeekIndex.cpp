@@ -0,0 +1,442 @@
+#include "SeekIndex.h"
+#include "AppData.h"
+
+namespace
+{
+    constexpr int tableMagic = 0x31494b53; // "SKI1"
+    constexpr int tableVersion = 1;
+
+    // one entry about every quarter of a second
+    constexpr double secondsPerEntry = 0.25;
+
+    // The first frames after a restart can borrow bits from frames we
+    // skipped, and the synthesis filter needs a frame to settle, so start
+    // decoding this many frames early and throw their output away.
+    constexpr int prerollFrames = 10;
+
+    struct FrameHeader
+    {
+        int size = 0;
+        int samples = 0;
+        int sampleRate = 0;
+    };
+
+    // Layer III only, which is all an .mp3 is in practice. Free-format
+    // streams have no frame size in the header, so they can't be indexed.
+    bool parseFrameHeader(const juce::uint8* h, FrameHeader& frame)
+    {
+        if (h[0] != 0xff || (h[1] & 0xe0) != 0xe0)
+            return false;
+
+        const int version = (h[1] >> 3) & 3; // 0: MPEG 2.5, 2: MPEG 2, 3: MPEG 1
+        const int layer = (h[1] >> 1) & 3;   // 1: Layer III
+        const int bitrateIndex = (h[2] >> 4) & 15;
+        const int rateIndex = (h[2] >> 2) & 3;
+        const int padding = (h[2] >> 1) & 1;
+
+        if (version == 1 || layer != 1 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+            return false;
+
+        static const int mpeg1Bitrates[] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+        static const int mpeg2Bitrates[] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 };
+        static const int mpeg1Rates[] = { 44100, 48000, 32000 };
+
+        const bool mpeg1 = version == 3;
+        const int bitrate = (mpeg1 ? mpeg1Bitrates : mpeg2Bitrates)[bitrateIndex] * 1000;
+
+        frame.sampleRate = mpeg1Rates[rateIndex] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+        frame.samples = mpeg1 ? 1152 : 576;
+        frame.size = (mpeg1 ? 144 : 72) * bitrate / frame.sampleRate + padding;
+        return true;
+    }
+
+    bool isVbrInfoFrame(const juce::uint8* frame, int frameSize)
+    {
+        const bool mpeg1 = ((frame[1] >> 3) & 3) == 3;
+        const bool mono = ((frame[3] >> 6) & 3) == 3;
+        const int offset = 4 + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+
+        return offset + 4 <= frameSize
+            && (std::memcmp(frame + offset, "Xing", 4) == 0 || std::memcmp(frame + offset, "Info", 4) == 0);
+    }
+}
+
+//==============================================================================
+// Decodes through whichever reader started closest before the position
+// asked for, restarting the format's decoder on a stream that begins at a
+// table entry whenever a read jumps, rather than letting it seek itself.
+// Opened while its table is still being built, it leaves seeking to the
+// decoder until the build job hands the table over.
+class SeekIndex::IndexedReader : public juce::AudioFormatReader
+{
+public:
+    IndexedReader(juce::AudioFormatReader* original, juce::AudioFormat& fileFormat,
+                  const juce::File& audioFile, TablePtr seekTable, std::shared_ptr<Handoff> pendingTable)
+        : juce::AudioFormatReader(nullptr, original->getFormatName()),
+          format(fileFormat),
+          file(audioFile),
+          pending(std::move(pendingTable)),
+          decoder(original)
+    {
+        sampleRate = original->sampleRate;
+        bitsPerSample = original->bitsPerSample;
+        numChannels = original->numChannels;
+        usesFloatingPointData = original->usesFloatingPointData;
+        metadataValues = original->metadataValues;
+        lengthInSamples = original->lengthInSamples;
+
+        // the scan counted every frame, which beats the decoder's estimate,
+        // but a late table can't change a length the caller has already seen
+        if (seekTable != nullptr)
+            lengthInSamples = seekTable->lengthInSamples;
+
+        adopt(std::move(seekTable));
+        scratch.setSize((int)numChannels, 4096);
+    }
+
+    bool readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                     juce::int64 startSampleInFile, int numSamples) override
+    {
+        clearSamplesBeyondAvailableLength(destChannels, numDestChannels, startOffsetInDestBuffer,
+                                          startSampleInFile, numSamples, lengthInSamples);
+
+        if (numSamples <= 0)
+            return true;
+
+        if (table == nullptr && pending != nullptr && pending->ready.load(std::memory_order_acquire))
+        {
+            adopt(pending->table);
+            pending.reset();
+        }
+
+        // without a table the decoder seeks itself, from its own start
+        if (table == nullptr)
+            position = startSampleInFile;
+        else if (startSampleInFile != position)
+            seek(startSampleInFile);
+
+        if (decoder == nullptr)
+        {
+            for (int channel = 0; channel < numDestChannels; ++channel)
+                if (destChannels[channel] != nullptr)
+                    juce::zeromem(destChannels[channel] + startOffsetInDestBuffer, (size_t)numSamples * sizeof(int));
+
+            return false;
+        }
+
+        // straight to the decoder, which would otherwise clamp to the length
+        // it estimated from its first frame
+        const bool ok = decoder->readSamples(destChannels, numDestChannels, startOffsetInDestBuffer,
+                                             position - decoderStart, numSamples);
+        position += numSamples;
+        return ok;
+    }
+
+private:
+    void adopt(TablePtr seekTable)
+    {
+        if (seekTable == nullptr || seekTable->entries.empty())
+            return;
+
+        table = std::move(seekTable);
+        prerollSamples = (juce::int64)prerollFrames * table->samplesPerFrame;
+    }
+
+    void seek(juce::int64 target)
+    {
+        // a short hop forward is cheaper to decode through than to restart for
+        const auto spacing = table->entries.size() > 1 ? table->entries[1].sample : (juce::int64)0;
+        if (decoder != nullptr && target > position && target - position <= spacing + prerollSamples)
+        {
+            skip(target - position);
+            return;
+        }
+
+        const auto& entry = table->findEntryBefore(juce::jmax((juce::int64)0, target - prerollSamples));
+
+        decoder.reset();
+        auto in = std::make_unique<juce::FileInputStream>(file);
+        if (in->openedOk())
+            decoder.reset(format.createReaderFor(new juce::SubregionStream(in.release(), entry.byteOffset, -1, true), true));
+
+        decoderStart = position = entry.sample;
+        if (decoder != nullptr)
+            skip(target - position);
+        else
+            position = target;
+    }
+
+    void skip(juce::int64 numSamples)
+    {
+        auto* const* channels = reinterpret_cast<int* const*>(scratch.getArrayOfWritePointers());
+
+        while (numSamples > 0)
+        {
+            const int count = (int)juce::jmin(numSamples, (juce::int64)scratch.getNumSamples());
+            decoder->readSamples(channels, (int)numChannels, 0, position - decoderStart, count);
+            position += count;
+            numSamples -= count;
+        }
+    }
+
+    juce::AudioFormat& format;
+    const juce::File file;
+    TablePtr table;
+    std::shared_ptr<Handoff> pending;
+    std::unique_ptr<juce::AudioFormatReader> decoder;
+    juce::int64 decoderStart = 0; // where the decoder's stream begins, in samples
+    juce::int64 position = 0;     // the next sample the decoder will produce
+    juce::int64 prerollSamples = 0;
+    juce::AudioBuffer<float> scratch;
+};
+
+//==============================================================================
+const SeekIndex::Table::Entry& SeekIndex::Table::findEntryBefore(juce::int64 sample) const
+{
+    jassert(!entries.empty());
+
+    auto next = std::upper_bound(entries.begin(), entries.end(), sample,
+                                 [](juce::int64 s, const Entry& entry) { return s < entry.sample; });
+
+    return next == entries.begin() ? entries.front() : *std::prev(next);
+}
+
+SeekIndex::SeekIndex()
+    : directory(getDefaultDirectory())
+{
+}
+
+SeekIndex::~SeekIndex()
+{
+    buildPool.removeAllJobs(true, 4000);
+}
+
+juce::File SeekIndex::getDefaultDirectory()
+{
+    return getAppDataDirectory().getChildFile("SeekIndex");
+}
+
+juce::File SeekIndex::getTableFileFor(const juce::File& audioFile) const
+{
+    const auto key = audioFile.getFullPathName()
+        + "|" + juce::String(audioFile.getSize())
+        + "|" + juce::String(audioFile.getLastModificationTime().toMilliseconds());
+
+    return directory.getChildFile(juce::String::toHexString(key.hashCode64()) + ".ski");
+}
+
+SeekIndex::TablePtr SeekIndex::getTable(const juce::File& audioFile)
+{
+    return lookUp(audioFile, nullptr);
+}
+
+SeekIndex::TablePtr SeekIndex::lookUp(const juce::File& audioFile, std::shared_ptr<Handoff>* pending)
+{
+    if (!canIndex(audioFile))
+        return nullptr;
+
+    const auto tableFile = getTableFileFor(audioFile);
+    const auto key = tableFile.getFileName();
+    const auto sourceSize = audioFile.getSize();
+    const auto sourceTime = audioFile.getLastModificationTime().toMilliseconds();
+
+    const juce::ScopedLock sl(lock);
+
+    auto open = openTables.find(key);
+    if (open != openTables.end())
+        if (auto table = open->second.lock())
+            return table;
+
+    if (TablePtr table = load(tableFile, sourceSize, sourceTime))
+    {
+        openTables[key] = table;
+        return table;
+    }
+
+    auto existing = building.find(key);
+    if (existing != building.end())
+    {
+        if (pending != nullptr)
+            *pending = existing->second;
+
+        return nullptr;
+    }
+
+    auto handoff = std::make_shared<Handoff>();
+    building.emplace(key, handoff);
+
+    if (pending != nullptr)
+        *pending = handoff;
+
+    buildPool.addJob([this, audioFile, tableFile, key, sourceSize, sourceTime, handoff]
+    {
+        TablePtr table = build(audioFile);
+        if (table != nullptr)
+            save(*table, tableFile, sourceSize, sourceTime);
+
+        const juce::ScopedLock buildLock(lock);
+        building.erase(key);
+
+        if (table != nullptr)
+        {
+            openTables[key] = table;
+
+            // readers opened while we were busy pick it up on their next read
+            handoff->table = std::move(table);
+            handoff->ready.store(true, std::memory_order_release);
+        }
+    });
+
+    return nullptr;
+}
+
+juce::AudioFormatReader* SeekIndex::createReaderFor(juce::AudioFormatManager& formatManager, const juce::File& audioFile)
+{
+    auto* reader = formatManager.createReaderFor(audioFile);
+    if (reader == nullptr)
+        return nullptr;
+
+    std::shared_ptr<Handoff> pending;
+    auto table = lookUp(audioFile, &pending);
+    if ((table == nullptr || table->entries.empty()) && pending == nullptr)
+        return reader;
+
+    for (int i = 0; i < formatManager.getNumKnownFormats(); ++i)
+    {
+        auto* format = formatManager.getKnownFormat(i);
+        if (format->getFormatName() == reader->getFormatName())
+            return new IndexedReader(reader, *format, audioFile, std::move(table), std::move(pending));
+    }
+
+    return reader;
+}
+
+std::shared_ptr<SeekIndex::Table> SeekIndex::build(const juce::File& audioFile)
+{
+    juce::MemoryMappedFile map(audioFile, juce::MemoryMappedFile::readOnly);
+    const auto* data = static_cast<const juce::uint8*>(map.getData());
+    const auto size = (juce::int64)map.getSize();
+
+    if (data == nullptr || size < 10)
+        return nullptr;
+
+    juce::int64 offset = 0;
+    if (data[0] == 'I' && data[1] == 'D' && data[2] == '3')
+        offset = 10 + (((data[6] & 0x7f) << 21) | ((data[7] & 0x7f) << 14) | ((data[8] & 0x7f) << 7) | (data[9] & 0x7f))
+                    + ((data[5] & 0x10) != 0 ? 10 : 0);
+
+    auto table = std::make_shared<Table>();
+    int framesPerEntry = 0;
+    juce::int64 frameIndex = 0;
+    bool checkedInfoFrame = false;
+
+    while (offset + 4 <= size)
+    {
+        if ((frameIndex & 0xffff) == 0)
+            if (auto* job = juce::ThreadPoolJob::getCurrentThreadPoolJob())
+                if (job->shouldExit())
+                    return nullptr;
+
+        FrameHeader frame;
+        if (!parseFrameHeader(data + offset, frame) || offset + frame.size > size)
+        {
+            // Junk between frames, or trailing tags: look for the next header
+            // whose frame is followed by another one, so a stray 0xff in tag
+            // data doesn't pass for a frame.
+            FrameHeader following;
+            do
+            {
+                ++offset;
+            } while (offset + 4 <= size
+                     && !(parseFrameHeader(data + offset, frame) && offset + frame.size + 4 <= size
+                          && parseFrameHeader(data + offset + frame.size, following)));
+
+            if (offset + 4 > size)
+                break;
+        }
+
+        // the encoder's info frame is silent and decoders skip it
+        if (!checkedInfoFrame)
+        {
+            checkedInfoFrame = true;
+            if (isVbrInfoFrame(data + offset, (int)juce::jmin((juce::int64)frame.size, size - offset)))
+            {
+                offset += frame.size;
+                continue;
+            }
+        }
+
+        if (framesPerEntry == 0)
+        {
+            table->samplesPerFrame = frame.samples;
+            framesPerEntry = juce::jmax(1, juce::roundToInt(secondsPerEntry * frame.sampleRate / frame.samples));
+        }
+
+        if (frameIndex % framesPerEntry == 0)
+            table->entries.push_back({ offset, table->lengthInSamples });
+
+        table->lengthInSamples += frame.samples;
+        offset += frame.size;
+        ++frameIndex;
+    }
+
+    if (table->entries.empty())
+        return nullptr;
+
+    return table;
+}
+
+std::shared_ptr<SeekIndex::Table> SeekIndex::load(const juce::File& tableFile, juce::int64 sourceSize,
+                                                  juce::int64 sourceModificationTime)
+{
+    juce::MemoryBlock data;
+    if (!tableFile.existsAsFile() || !tableFile.loadFileAsData(data))
+        return nullptr;
+
+    juce::MemoryInputStream in(data, false);
+    if (in.readInt() != tableMagic || in.readInt() != tableVersion
+        || in.readInt64() != sourceSize || in.readInt64() != sourceModificationTime)
+        return nullptr;
+
+    auto table = std::make_shared<Table>();
+    table->lengthInSamples = in.readInt64();
+    table->samplesPerFrame = in.readInt();
+
+    const int count = in.readInt();
+    if (count <= 0 || in.getNumBytesRemaining() < (juce::int64)count * 16)
+        return nullptr;
+
+    table->entries.resize((size_t)count);
+    for (auto& entry : table->entries)
+    {
+        entry.byteOffset = in.readInt64();
+        entry.sample = in.readInt64();
+    }
+
+    return table;
+}
+
+bool SeekIndex::save(const Table& table, const juce::File& tableFile, juce::int64 sourceSize,
+                     juce::int64 sourceModificationTime)
+{
+    juce::MemoryOutputStream out;
+    out.writeInt(tableMagic);
+    out.writeInt(tableVersion);
+    out.writeInt64(sourceSize);
+    out.writeInt64(sourceModificationTime);
+    out.writeInt64(table.lengthInSamples);
+    out.writeInt(table.samplesPerFrame);
+    out.writeInt((int)table.entries.size());
+
+    for (const auto& entry : table.entries)
+    {
+        out.writeInt64(entry.byteOffset);
+        out.writeInt64(entry.sample);
+    }
+
+    tableFile.getParentDirectory().createDirectory();
+
+    juce::TemporaryFile temp(tableFile);
+    return temp.getFile().replaceWithData(out.getData(), out.getDataSize())
+        && temp.overwriteTargetFileWithTemporary();
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <JuceHeader.h>
+#include <map>
+
+// Seek tables for MP3s, whose frames can only be found by walking the file
+// from the start, so a decoder's seek either scans or guesses. Each file
+// gets the byte offset and exact first sample of a frame every quarter of a
+// second, stored with the library data and keyed by the file's path, size
+// and modification time. Readers from createReaderFor() use the table to
+// restart the decoder just before any position, so a jump costs a fraction
+// of a second of decoding wherever it lands.
+// Shared between decks through juce::SharedResourcePointer<SeekIndex>.
+class SeekIndex
+{
+public:
+    struct Table
+    {
+        struct Entry
+        {
+            juce::int64 byteOffset = 0;
+            juce::int64 sample = 0;
+        };
+
+        std::vector<Entry> entries;
+        juce::int64 lengthInSamples = 0;
+        int samplesPerFrame = 1152;
+
+        // the last entry starting at or before the sample
+        const Entry& findEntryBefore(juce::int64 sample) const;
+    };
+
+    using TablePtr = std::shared_ptr<const Table>;
+
+    SeekIndex();
+    ~SeekIndex();
+
+    // The table for this file if it has been built, or nullptr. The first
+    // request for a file that can be indexed starts building it in the
+    // background.
+    TablePtr getTable(const juce::File& audioFile);
+
+    // Opens the file with the format manager; if it has a table, the reader
+    // that comes back seeks with it. If the table is still being built, the
+    // reader seeks the decoder's own way until the build finishes and then
+    // switches to the table, so the first time a file is played benefits
+    // too. The caller owns the result.
+    juce::AudioFormatReader* createReaderFor(juce::AudioFormatManager& formatManager, const juce::File& audioFile);
+
+    static bool canIndex(const juce::File& audioFile) { return audioFile.hasFileExtension(".mp3"); }
+    static juce::File getDefaultDirectory();
+
+private:
+    class IndexedReader;
+
+    // Passes a table from the build job to readers opened before it was
+    // done. table is written once, before ready is set.
+    struct Handoff
+    {
+        std::atomic<bool> ready{ false };
+        TablePtr table;
+    };
+
+    TablePtr lookUp(const juce::File& audioFile, std::shared_ptr<Handoff>* pending);
+
+    juce::File getTableFileFor(const juce::File& audioFile) const;
+    static std::shared_ptr<Table> build(const juce::File& audioFile);
+    static std::shared_ptr<Table> load(const juce::File& tableFile, juce::int64 sourceSize, juce::int64 sourceModificationTime);
+    static bool save(const Table& table, const juce::File& tableFile, juce::int64 sourceSize, juce::int64 sourceModificationTime);
+
+    juce::File directory;
+    juce::ThreadPool buildPool{ 1 };
+
+    juce::CriticalSection lock;
+    std::map<juce::String, std::weak_ptr<const Table>> openTables;
+    std::map<juce::String, std::shared_ptr<Handoff>> building;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SeekIndex)
+};
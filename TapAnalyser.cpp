@@ -0,0 +1,279 @@
+#include "TapAnalyser.h"
+
+namespace
+{
+    constexpr double rmsSeconds = 0.3;
+    constexpr int stepsPerShortTerm = 30;    // 100ms steps in 3s
+    constexpr int stepsPerMomentary = 4;     // ... in 400ms
+    constexpr float spectrumFallPerPass = 1.5f;
+}
+
+struct TapAnalyser::TapState
+{
+    explicit TapState(AudioTap& t)
+        : tap(t),
+          fft(fftOrder),
+          history((size_t)fft.getSize(), 0.0f),
+          window((size_t)fft.getSize()),
+          windowed((size_t)fft.getSize()),
+          bins((size_t)fft.getSize()),
+          power((size_t)fft.getSize() / 2 + 1),
+          scratch(AudioTap::numChannels, 4096)
+    {
+        const int size = fft.getSize();
+        for (int i = 0; i < size; ++i)
+            window[(size_t)i] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * (float)i / (float)size);
+    }
+
+    void configure(double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        kWeighting.setSampleRate(sampleRate);
+        samplesPerStep = juce::jmax(1, juce::roundToInt(sampleRate * 0.1));
+        stepFill = 0;
+        stepEnergy = 0.0;
+        steps.fill(0.0);
+        numSteps = 0;
+        rmsCoefficient = 1.0 - std::exp(-1.0 / (sampleRate * rmsSeconds));
+
+        // each band takes the bins between its edges, or the nearest one
+        // where it's narrower than a bin
+        const double binHz = sampleRate / fft.getSize();
+        const int lastBin = (int)power.size() - 1;
+        for (int band = 0; band < numBands; ++band)
+        {
+            const int first = juce::jlimit(1, lastBin, (int)std::floor(getBandLowFrequency(band) / binHz));
+            const int last = juce::jlimit(first, lastBin, (int)std::ceil(getBandLowFrequency(band + 1) / binHz) - 1);
+            bandFirstBin[(size_t)band] = first;
+            bandLastBin[(size_t)band] = last;
+        }
+    }
+
+    AudioTap& tap;
+    double sampleRate = 0.0;
+
+    // levels
+    double meanSquare[AudioTap::numChannels] = {};
+    double rmsCoefficient = 0.0;
+
+    // loudness, from the K-weighted energy of each 100ms step
+    KWeighting kWeighting;
+    int samplesPerStep = 1;
+    int stepFill = 0;
+    double stepEnergy = 0.0;
+    std::array<double, stepsPerShortTerm> steps{};
+    int numSteps = 0;
+
+    // spectrum of the latest fft-sized stretch of the mono mix
+    Fft fft;
+    std::vector<float> history;
+    int historyPosition = 0;
+    std::vector<float> window, windowed;
+    std::vector<std::complex<float>> bins;
+    std::vector<float> power;
+    std::array<int, numBands> bandFirstBin{}, bandLastBin{};
+
+    juce::AudioBuffer<float> scratch;
+    Frame working;
+
+    // guarded by frameLock
+    Frame published;
+    bool hasFrame = false;
+};
+
+//==============================================================================
+TapAnalyser::TapAnalyser()
+    : juce::Thread("Tap Analyser")
+{
+    startThread(juce::Thread::Priority::low);
+}
+
+TapAnalyser::~TapAnalyser()
+{
+    stopThread(1000);
+}
+
+float TapAnalyser::getBandLowFrequency(int band)
+{
+    return 20.0f * std::pow(1000.0f, (float)band / (float)numBands);
+}
+
+void TapAnalyser::addTap(AudioTap& tap)
+{
+    const juce::ScopedLock sl(lock);
+    states.push_back(std::make_unique<TapState>(tap));
+}
+
+void TapAnalyser::removeTap(AudioTap& tap)
+{
+    const juce::ScopedLock sl(lock);
+    states.erase(std::remove_if(states.begin(), states.end(),
+                                [&tap](const std::unique_ptr<TapState>& s) { return &s->tap == &tap; }),
+                 states.end());
+}
+
+bool TapAnalyser::getLatestFrame(const AudioTap& tap, Frame& frame)
+{
+    // only the message thread changes the list, so reading it here needs no
+    // lock, and never waits for a pass to finish
+    for (auto& state : states)
+    {
+        if (&state->tap != &tap)
+            continue;
+
+        const juce::SpinLock::ScopedLockType frameSl(frameLock);
+        if (!state->hasFrame)
+            return false;
+
+        frame = state->published;
+        std::fill(std::begin(state->published.peak), std::end(state->published.peak), 0.0f);
+        return true;
+    }
+
+    return false;
+}
+
+void TapAnalyser::run()
+{
+    while (!threadShouldExit())
+    {
+        {
+            const juce::ScopedLock sl(lock);
+            for (auto& state : states)
+                analyse(*state);
+        }
+
+        wait(passMilliseconds);
+    }
+}
+
+void TapAnalyser::analyse(TapState& s)
+{
+    const double sampleRate = s.tap.getSampleRate();
+    if (sampleRate <= 0.0)
+        return;
+
+    if (sampleRate != s.sampleRate)
+        s.configure(sampleRate);
+
+    auto& frame = s.working;
+    std::fill(std::begin(frame.peak), std::end(frame.peak), 0.0f);
+
+    const int historySize = (int)s.history.size();
+    bool anyNewSamples = false;
+
+    for (int numSamples; (numSamples = s.tap.pull(s.scratch)) > 0;)
+    {
+        anyNewSamples = true;
+
+        for (int channel = 0; channel < AudioTap::numChannels; ++channel)
+        {
+            const float* data = s.scratch.getReadPointer(channel);
+            frame.peak[channel] = juce::jmax(frame.peak[channel], s.scratch.getMagnitude(channel, 0, numSamples));
+
+            double meanSquare = s.meanSquare[channel];
+            for (int i = 0; i < numSamples; ++i)
+                meanSquare += ((double)data[i] * data[i] - meanSquare) * s.rmsCoefficient;
+            s.meanSquare[channel] = meanSquare;
+        }
+
+        for (int done = 0; done < numSamples;)
+        {
+            const int count = juce::jmin(numSamples - done, s.samplesPerStep - s.stepFill);
+
+            for (int channel = 0; channel < AudioTap::numChannels; ++channel)
+            {
+                const float* data = s.scratch.getReadPointer(channel, done);
+                for (int i = 0; i < count; ++i)
+                {
+                    const double y = s.kWeighting.process(channel, data[i]);
+                    s.stepEnergy += y * y;
+                }
+            }
+
+            done += count;
+            s.stepFill += count;
+
+            if (s.stepFill == s.samplesPerStep)
+            {
+                std::move(s.steps.begin() + 1, s.steps.end(), s.steps.begin());
+                s.steps.back() = s.stepEnergy / s.samplesPerStep;
+                s.numSteps = juce::jmin(s.numSteps + 1, stepsPerShortTerm);
+                s.stepEnergy = 0.0;
+                s.stepFill = 0;
+            }
+        }
+
+        // the mono mix goes into a ring of the latest samples
+        for (int done = 0; done < numSamples;)
+        {
+            const int count = juce::jmin(numSamples - done, historySize - s.historyPosition);
+            float* dest = s.history.data() + s.historyPosition;
+
+            juce::FloatVectorOperations::copyWithMultiply(dest, s.scratch.getReadPointer(0, done), 0.5f, count);
+            juce::FloatVectorOperations::addWithMultiply(dest, s.scratch.getReadPointer(1, done), 0.5f, count);
+
+            done += count;
+            s.historyPosition = (s.historyPosition + count) % historySize;
+        }
+    }
+
+    for (int channel = 0; channel < AudioTap::numChannels; ++channel)
+        frame.rms[channel] = (float)std::sqrt(s.meanSquare[channel]);
+
+    auto meanOfLastSteps = [&s](int count)
+    {
+        count = juce::jmin(count, s.numSteps);
+        if (count == 0)
+            return 0.0;
+
+        double sum = 0.0;
+        for (int i = stepsPerShortTerm - count; i < stepsPerShortTerm; ++i)
+            sum += s.steps[(size_t)i];
+        return sum / count;
+    };
+
+    frame.momentaryLoudness = juce::jmax(-70.0f, (float)KWeighting::toLufs(meanOfLastSteps(stepsPerMomentary)));
+    frame.shortTermLoudness = juce::jmax(-70.0f, (float)KWeighting::toLufs(meanOfLastSteps(stepsPerShortTerm)));
+
+    if (anyNewSamples)
+    {
+        // unroll the ring oldest-first through the window
+        const int tail = historySize - s.historyPosition;
+        juce::FloatVectorOperations::multiply(s.windowed.data(), s.history.data() + s.historyPosition, s.window.data(), tail);
+        juce::FloatVectorOperations::multiply(s.windowed.data() + tail, s.history.data(), s.window.data() + tail, s.historyPosition);
+
+        for (int i = 0; i < historySize; ++i)
+            s.bins[(size_t)i] = { s.windowed[(size_t)i], 0.0f };
+
+        s.fft.perform(s.bins.data());
+
+        for (size_t k = 0; k < s.power.size(); ++k)
+            s.power[k] = std::norm(s.bins[k]);
+
+        // a full-scale sine through a Hann window peaks at a quarter of the
+        // FFT size
+        const float fullScale = juce::square((float)historySize * 0.25f);
+
+        for (int band = 0; band < numBands; ++band)
+        {
+            const int first = s.bandFirstBin[(size_t)band];
+            const auto range = juce::FloatVectorOperations::findMinAndMax(s.power.data() + first,
+                                                                          s.bandLastBin[(size_t)band] - first + 1);
+            const float db = 10.0f * std::log10(juce::jmax(range.getEnd() / fullScale, 1.0e-10f));
+
+            // rise at once, fall gradually, like an analogue display
+            auto& shown = frame.spectrum[(size_t)band];
+            shown = juce::jmax(db, shown - spectrumFallPerPass);
+        }
+    }
+
+    const juce::SpinLock::ScopedLockType sl(frameLock);
+
+    // peaks collect until a display reads them, so none fall between reads
+    for (int channel = 0; channel < AudioTap::numChannels; ++channel)
+        frame.peak[channel] = juce::jmax(frame.peak[channel], s.published.peak[channel]);
+
+    s.published = frame;
+    s.hasFrame = true;
+}
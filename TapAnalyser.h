@@ -0,0 +1,57 @@
+#pragma once
+#include <JuceHeader.h>
+#include "AudioTap.h"
+#include "Fft.h"
+#include "KWeighting.h"
+
+// Turns what AudioTaps capture into meter readings and a spectrum, on one
+// background thread shared by every tap, about sixty times a second. Each
+// pass drains every registered tap and publishes a Frame for it; displays
+// pick up the latest frame whenever they repaint. The audio threads only
+// ever write into their taps, so nothing here can hold them up.
+// Shared through juce::SharedResourcePointer<TapAnalyser>.
+class TapAnalyser : private juce::Thread
+{
+public:
+    static constexpr int numBands = 48;
+
+    struct Frame
+    {
+        Frame() { spectrum.fill(-100.0f); }
+
+        float peak[AudioTap::numChannels] = {};  // highest since the frame was last read, linear
+        float rms[AudioTap::numChannels] = {};   // over about 300ms, linear
+        float momentaryLoudness = -70.0f;        // LUFS over 400ms
+        float shortTermLoudness = -70.0f;        // LUFS over 3s
+        std::array<float, numBands> spectrum;    // dBFS, log-spaced bands from 20Hz to 20kHz
+    };
+
+    TapAnalyser();
+    ~TapAnalyser() override;
+
+    // Message thread. removeTap() returns once the analyser has let go of
+    // the tap, so it can be deleted.
+    void addTap(AudioTap& tap);
+    void removeTap(AudioTap& tap);
+
+    // Message thread. Copies out the tap's most recent frame, and starts
+    // collecting its peaks afresh. False if the tap hasn't produced one yet.
+    bool getLatestFrame(const AudioTap& tap, Frame& frame);
+
+    static float getBandLowFrequency(int band);
+
+private:
+    struct TapState;
+
+    void run() override;
+    void analyse(TapState& state);
+
+    juce::CriticalSection lock;   // guards states; held for a whole pass
+    juce::SpinLock frameLock;     // guards the published frames
+    std::vector<std::unique_ptr<TapState>> states;
+
+    static constexpr int fftOrder = 12;
+    static constexpr int passMilliseconds = 16;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TapAnalyser)
+};
@@ -0,0 +1,81 @@
+#include "TapDisplay.h"
+
+TapDisplay::TapDisplay(AudioTap& tapToShow)
+    : tap(tapToShow)
+{
+    analyser->addTap(tap);
+    setInterceptsMouseClicks(false, false);
+    startTimerHz(30);
+}
+
+TapDisplay::~TapDisplay()
+{
+    stopTimer();
+    analyser->removeTap(tap);
+}
+
+void TapDisplay::timerCallback()
+{
+    if (!analyser->getLatestFrame(tap, frame))
+        return;
+
+    // peaks fall back slowly enough to read
+    for (int channel = 0; channel < AudioTap::numChannels; ++channel)
+        heldPeak[channel] = juce::jmax(frame.peak[channel], heldPeak[channel] * 0.9f);
+
+    repaint();
+}
+
+void TapDisplay::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colours::black.withAlpha(0.4f));
+
+    auto area = getLocalBounds().reduced(2);
+    auto meters = area.removeFromLeft(juce::jmin(90, area.getWidth() / 3));
+    area.removeFromLeft(4);
+
+    auto toProportion = [](float gain, float floor)
+    {
+        const float db = juce::Decibels::gainToDecibels(gain, floor);
+        return juce::jlimit(0.0f, 1.0f, (db - floor) / -floor);
+    };
+
+    // loudness readout under two horizontal level bars
+    auto readout = meters.removeFromBottom(14);
+    g.setColour(juce::Colours::lightgrey);
+    g.setFont(11.0f);
+    g.drawText(juce::String(frame.momentaryLoudness, 1) + " LUFS", readout, juce::Justification::centredLeft);
+
+    const int barHeight = meters.getHeight() / AudioTap::numChannels;
+    for (int channel = 0; channel < AudioTap::numChannels; ++channel)
+    {
+        auto bar = meters.removeFromTop(barHeight).reduced(0, 1).toFloat();
+
+        g.setColour(juce::Colours::darkgrey);
+        g.fillRect(bar);
+
+        const float rms = toProportion(frame.rms[channel], floorDb);
+        g.setColour(heldPeak[channel] >= 1.0f ? juce::Colours::red : juce::Colours::limegreen);
+        g.fillRect(bar.withWidth(bar.getWidth() * rms));
+
+        const float peakX = bar.getX() + bar.getWidth() * toProportion(heldPeak[channel], floorDb);
+        g.setColour(juce::Colours::white);
+        g.drawVerticalLine(juce::roundToInt(peakX), bar.getY(), bar.getBottom());
+    }
+
+    // spectrum
+    if (area.getWidth() <= 0)
+        return;
+
+    const auto spectrumArea = area.toFloat();
+    const float bandWidth = spectrumArea.getWidth() / (float)TapAnalyser::numBands;
+    g.setColour(juce::Colours::skyblue.withAlpha(0.8f));
+
+    for (int band = 0; band < TapAnalyser::numBands; ++band)
+    {
+        const float level = juce::jlimit(0.0f, 1.0f, (frame.spectrum[(size_t)band] - spectrumFloorDb) / -spectrumFloorDb);
+        const float height = spectrumArea.getHeight() * level;
+        g.fillRect(spectrumArea.getX() + band * bandWidth, spectrumArea.getBottom() - height,
+                   juce::jmax(1.0f, bandWidth - 1.0f), height);
+    }
+}
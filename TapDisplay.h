@@ -0,0 +1,29 @@
+#pragma once
+#include <JuceHeader.h>
+#include "TapAnalyser.h"
+
+// Peak and RMS meters, the momentary loudness and a spectrum for one
+// AudioTap, from the frames the shared TapAnalyser produces. Registers the
+// tap with the analyser for as long as it exists.
+class TapDisplay : public juce::Component,
+    private juce::Timer
+{
+public:
+    explicit TapDisplay(AudioTap& tapToShow);
+    ~TapDisplay() override;
+
+    void paint(juce::Graphics& g) override;
+
+private:
+    void timerCallback() override;
+
+    AudioTap& tap;
+    juce::SharedResourcePointer<TapAnalyser> analyser;
+    TapAnalyser::Frame frame;
+    float heldPeak[AudioTap::numChannels] = {};
+
+    static constexpr float floorDb = -60.0f;
+    static constexpr float spectrumFloorDb = -90.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TapDisplay)
+};
@@ -0,0 +1,225 @@
+#include "TimeStretcher.h"
+#include "AudioProfiler.h"
+
+TimeStretcher::TimeStretcher(juce::AudioSource* inputSource, int maxNumChannels)
+    : input(inputSource),
+      numChannels(juce::jmax(1, maxNumChannels))
+{
+    jassert(input != nullptr);
+}
+
+TimeStretcher::~TimeStretcher() = default;
+
+void TimeStretcher::setEnabled(bool shouldBeEnabled)
+{
+    if (enabled != shouldBeEnabled)
+    {
+        enabled = shouldBeEnabled;
+        reset();
+    }
+}
+
+void TimeStretcher::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    // about 20ms frames: long enough to hold a couple of pitch periods of
+    // most material, short enough not to smear transients
+    frameSize = sampleRate > 50000.0 ? 2048 : 1024;
+    hopSize = frameSize / 2;
+    tolerance = hopSize / 2;
+
+    // finish each search within the callbacks that play out one hop
+    const int numCandidates = 2 * tolerance + 1;
+    candidatesPerBlock = numCandidates * juce::jmax(1, samplesPerBlockExpected) / hopSize + 1;
+
+    // periodic Hann, so frames one hop apart sum to exactly one
+    window.resize((size_t)frameSize);
+    for (int i = 0; i < frameSize; ++i)
+        window[(size_t)i] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * (float)i / (float)frameSize);
+
+    inputBuffer.setSize(numChannels, frameSize * 4);
+    monoBuffer.assign((size_t)(frameSize * 4), 0.0f);
+    accumulator.setSize(numChannels, frameSize);
+    ready.setSize(numChannels, hopSize);
+    reset();
+
+    input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void TimeStretcher::releaseResources()
+{
+    input->releaseResources();
+    frameSize = 0;
+}
+
+void TimeStretcher::reset()
+{
+    inputStart = inputEnd = 0;
+    accumulator.clear();
+    readyPosition = readyCount = 0;
+
+    // the first frame has nothing to line up with, so take it where it is
+    frameStart = 0;
+    analysisPosition = 0.0;
+    searchNominal = 0;
+    searchTarget = 0;
+    bestOffset = 0;
+    searchDone = true;
+}
+
+void TimeStretcher::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    if (!enabled || frameSize == 0)
+    {
+        input->getNextAudioBlock(bufferToFill);
+        return;
+    }
+
+    AudioProfiler::ScopedStage stage(AudioProfiler::Stage::stretch);
+
+    const int outputChannels = juce::jmin(bufferToFill.buffer->getNumChannels(), numChannels);
+
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        if (readyCount == 0)
+            completeFrame();
+
+        const int chunk = juce::jmin(bufferToFill.numSamples - done, readyCount);
+
+        for (int channel = 0; channel < outputChannels; ++channel)
+            bufferToFill.buffer->copyFrom(channel, bufferToFill.startSample + done, ready, channel, readyPosition, chunk);
+
+        readyPosition += chunk;
+        readyCount -= chunk;
+        done += chunk;
+    }
+
+    for (int channel = outputChannels; channel < bufferToFill.buffer->getNumChannels(); ++channel)
+        bufferToFill.buffer->clear(channel, bufferToFill.startSample, bufferToFill.numSamples);
+
+    // Background work for the next frame, in slices sized so that it keeps
+    // pace with playback: roughly this block's worth of input, and this
+    // block's share of the candidate offsets.
+    if (!searchDone)
+    {
+        const auto searchEnd = searchNominal + tolerance + hopSize;
+        ensureInputUpTo(juce::jmin(searchEnd, inputEnd + (juce::int64)std::ceil(bufferToFill.numSamples * tempo) + 1));
+        continueSearch(candidatesPerBlock);
+    }
+}
+
+void TimeStretcher::ensureInputUpTo(juce::int64 endPosition)
+{
+    const int capacity = inputBuffer.getNumSamples();
+    const int offset = (int)(inputEnd - inputStart);
+    const int needed = (int)juce::jmin(endPosition - inputEnd, (juce::int64)(capacity - offset));
+
+    if (needed <= 0)
+        return;
+
+    juce::AudioBuffer<float> view(inputBuffer.getArrayOfWritePointers(), numChannels, capacity);
+    input->getNextAudioBlock(juce::AudioSourceChannelInfo(&view, offset, needed));
+
+    auto* mono = monoBuffer.data() + offset;
+    juce::FloatVectorOperations::copy(mono, inputBuffer.getReadPointer(0, offset), needed);
+    for (int channel = 1; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::add(mono, inputBuffer.getReadPointer(channel, offset), needed);
+
+    inputEnd += needed;
+}
+
+void TimeStretcher::discardInputBefore(juce::int64 position)
+{
+    const int shift = (int)(juce::jmin(position, inputEnd) - inputStart);
+    if (shift <= 0)
+        return;
+
+    const int remaining = (int)(inputEnd - inputStart) - shift;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto* data = inputBuffer.getWritePointer(channel);
+        std::memmove(data, data + shift, (size_t)remaining * sizeof(float));
+    }
+
+    std::memmove(monoBuffer.data(), monoBuffer.data() + shift, (size_t)remaining * sizeof(float));
+    inputStart += shift;
+}
+
+void TimeStretcher::startSearch()
+{
+    searchNominal = (juce::int64)std::llround(analysisPosition);
+    searchTarget = frameStart + hopSize;
+    searchOffset = (int)juce::jmax((juce::int64)-tolerance, inputStart - searchNominal);
+    bestOffset = 0;
+    bestScore = -std::numeric_limits<float>::max();
+    searchDone = false;
+}
+
+void TimeStretcher::continueSearch(int numCandidates)
+{
+    // Compare each candidate against what would have followed the previous
+    // frame, over the hop where the two will overlap. Every fourth sample is
+    // plenty to find the best alignment, and quarters the cost.
+    constexpr int stride = 4;
+    const auto* target = monoBuffer.data() + (searchTarget - inputStart);
+
+    for (; numCandidates > 0 && searchOffset <= tolerance; --numCandidates, ++searchOffset)
+    {
+        const auto candidateStart = searchNominal + searchOffset;
+        if (candidateStart + hopSize > inputEnd)
+            return; // wait for more input
+
+        const auto* candidate = monoBuffer.data() + (candidateStart - inputStart);
+        float correlation = 0.0f, energy = 0.0f;
+
+        for (int i = 0; i < hopSize; i += stride)
+        {
+            correlation += target[i] * candidate[i];
+            energy += candidate[i] * candidate[i];
+        }
+
+        const float score = correlation / std::sqrt(energy + 1.0e-9f);
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestOffset = searchOffset;
+        }
+    }
+
+    searchDone = searchOffset > tolerance;
+}
+
+void TimeStretcher::completeFrame()
+{
+    // normally the search finished over the previous callbacks; this only
+    // catches up when blocks are larger than a hop or input arrived late
+    if (!searchDone)
+    {
+        ensureInputUpTo(searchNominal + tolerance + hopSize);
+        continueSearch(std::numeric_limits<int>::max());
+    }
+
+    const auto chosen = searchNominal + bestOffset;
+    ensureInputUpTo(chosen + frameSize);
+
+    const int offset = (int)(chosen - inputStart);
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto* sum = accumulator.getWritePointer(channel);
+        juce::FloatVectorOperations::addWithMultiply(sum, inputBuffer.getReadPointer(channel, offset), window.data(), frameSize);
+
+        // the first hop has now had both of its frames added, so it's done
+        ready.copyFrom(channel, 0, sum, hopSize);
+        std::memmove(sum, sum + hopSize, (size_t)(frameSize - hopSize) * sizeof(float));
+        juce::FloatVectorOperations::clear(sum + frameSize - hopSize, hopSize);
+    }
+
+    readyPosition = 0;
+    readyCount = hopSize;
+
+    frameStart = chosen;
+    analysisPosition += hopSize * tempo;
+    startSearch();
+
+    discardInputBefore(juce::jmin(searchTarget, searchNominal + searchOffset));
+}
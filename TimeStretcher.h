@@ -0,0 +1,77 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Tempo change without pitch change, by WSOLA (waveform-similarity
+// overlap-add). Hann-windowed frames are taken from the input roughly
+// tempo * hop apart and overlap-added one hop apart, each one nudged to
+// where it best lines up with the natural continuation of the previous one.
+//
+// The similarity search for the next frame is spread over the callbacks that
+// play out the current one, a fixed number of candidate offsets per block,
+// so the cost per callback stays flat however small the device buffer is.
+class TimeStretcher : public juce::AudioSource
+{
+public:
+    explicit TimeStretcher(juce::AudioSource* input, int maxNumChannels = 2);
+    ~TimeStretcher() override;
+
+    // Input samples consumed per output sample. Audio thread only.
+    void setTempo(double newTempo) { tempo = juce::jlimit(0.25, 4.0, newTempo); }
+    double getTempo() const { return tempo; }
+
+    // When disabled the input is passed straight through. Audio thread only.
+    void setEnabled(bool shouldBeEnabled);
+    bool isEnabled() const { return enabled; }
+
+    // Drops all buffered audio, e.g. after the input has been repositioned.
+    void reset();
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+private:
+    void ensureInputUpTo(juce::int64 endPosition);
+    void discardInputBefore(juce::int64 position);
+    void startSearch();
+    void continueSearch(int numCandidates);
+    void completeFrame();
+
+    juce::AudioSource* input;
+    const int numChannels;
+    bool enabled = false;
+    double tempo = 1.0;
+
+    int frameSize = 0;
+    int hopSize = 0;
+    int tolerance = 0;
+    int candidatesPerBlock = 0;
+    std::vector<float> window;
+
+    // input history, with a mono mix of it for the similarity search;
+    // element 0 is at absolute input position inputStart
+    juce::AudioBuffer<float> inputBuffer;
+    std::vector<float> monoBuffer;
+    juce::int64 inputStart = 0;
+    juce::int64 inputEnd = 0;
+
+    // overlap-add accumulator and the finished samples waiting to be played
+    juce::AudioBuffer<float> accumulator;
+    juce::AudioBuffer<float> ready;
+    int readyPosition = 0;
+    int readyCount = 0;
+
+    // where the last frame was taken from, and where the next one ideally goes
+    juce::int64 frameStart = 0;
+    double analysisPosition = 0.0;
+
+    // search for the next frame's offset, advanced a slice per callback
+    juce::int64 searchNominal = 0;
+    juce::int64 searchTarget = 0;
+    int searchOffset = 0;
+    int bestOffset = 0;
+    float bestScore = 0.0f;
+    bool searchDone = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TimeStretcher)
+};
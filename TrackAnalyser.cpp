@@ -0,0 +1,564 @@
+#include "TrackAnalyser.h"
+#include "Fft.h"
+#include "KWeighting.h"
+#include <array>
+#include <numeric>
+
+namespace
+{
+    //==========================================================================
+    // Magnitude spectra of Hann-windowed, overlapping frames of a mono stream
+    // that arrives in arbitrary blocks.
+    class Stft
+    {
+    public:
+        Stft(int order, int hop)
+            : fft(order),
+              hopSize(hop),
+              window((size_t)fft.getSize()),
+              frame((size_t)fft.getSize()),
+              magnitudes((size_t)fft.getSize() / 2 + 1)
+        {
+            const int size = fft.getSize();
+            for (int i = 0; i < size; ++i)
+                window[(size_t)i] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * (float)i / (float)size);
+        }
+
+        int getFrameSize() const { return fft.getSize(); }
+        int getHopSize() const { return hopSize; }
+        int getNumBins() const { return (int)magnitudes.size(); }
+
+        template <typename Callback>
+        void push(const float* samples, int numSamples, Callback&& onFrame)
+        {
+            pending.insert(pending.end(), samples, samples + numSamples);
+
+            const int size = fft.getSize();
+            size_t start = 0;
+
+            for (; pending.size() - start >= (size_t)size; start += (size_t)hopSize)
+            {
+                for (int i = 0; i < size; ++i)
+                    frame[(size_t)i] = { pending[start + (size_t)i] * window[(size_t)i], 0.0f };
+
+                fft.perform(frame.data());
+
+                for (size_t k = 0; k < magnitudes.size(); ++k)
+                    magnitudes[k] = std::abs(frame[k]);
+
+                onFrame(magnitudes.data());
+            }
+
+            pending.erase(pending.begin(), pending.begin() + (std::ptrdiff_t)start);
+        }
+
+    private:
+        Fft fft;
+        int hopSize;
+        std::vector<float> window;
+        std::vector<std::complex<float>> frame;
+        std::vector<float> magnitudes;
+        std::vector<float> pending;
+    };
+
+    //==========================================================================
+    // Half-wave rectified spectral flux of log magnitudes: how much new energy
+    // each frame brings, which peaks on note and drum onsets.
+    class OnsetDetector
+    {
+    public:
+        explicit OnsetDetector(double sampleRate)
+            : stft(sampleRate > 50000.0 ? 12 : 11, sampleRate > 50000.0 ? 1024 : 512),
+              framesPerSecond(sampleRate / stft.getHopSize()),
+              frameCentreSeconds(0.5 * stft.getFrameSize() / sampleRate)
+        {
+            // above about 11kHz there's little but hi-hat noise
+            numBins = juce::jmin(stft.getNumBins(), (int)(11000.0 * stft.getFrameSize() / sampleRate));
+            logMagnitudes.resize((size_t)numBins);
+            previous.resize((size_t)numBins);
+            difference.resize((size_t)numBins);
+        }
+
+        void push(const float* samples, int numSamples)
+        {
+            stft.push(samples, numSamples, [this](const float* magnitudes)
+            {
+                for (int k = 0; k < numBins; ++k)
+                    logMagnitudes[(size_t)k] = std::log1p(100.0f * magnitudes[k]);
+
+                juce::FloatVectorOperations::subtract(difference.data(), logMagnitudes.data(), previous.data(), numBins);
+                juce::FloatVectorOperations::max(difference.data(), difference.data(), 0.0f, numBins);
+                std::swap(previous, logMagnitudes);
+
+                envelope.push_back(std::accumulate(difference.begin(), difference.end(), 0.0f));
+            });
+        }
+
+        Stft stft;
+        const double framesPerSecond;
+        const double frameCentreSeconds;
+        std::vector<float> envelope;
+
+    private:
+        int numBins = 0;
+        std::vector<float> logMagnitudes, previous, difference;
+    };
+
+    // Tempo from the autocorrelation of the onset envelope, weighted towards
+    // the tempos people actually dance to, then the phase of the grid that
+    // lines up with the most onsets.
+    void estimateTempo(const OnsetDetector& onsets, double& bpm, double& firstBeatSeconds)
+    {
+        const double fps = onsets.framesPerSecond;
+        const int minLag = (int)std::floor(fps * 60.0 / 200.0);
+        const int maxLag = (int)std::ceil(fps * 60.0 / 60.0);
+        const int n = (int)onsets.envelope.size();
+
+        if (minLag < 2 || n < maxLag * 8)
+            return;
+
+        // subtract a one-second running mean, so loud sections don't dominate
+        std::vector<double> sums((size_t)n + 1, 0.0);
+        for (int t = 0; t < n; ++t)
+            sums[(size_t)t + 1] = sums[(size_t)t] + onsets.envelope[(size_t)t];
+
+        const int radius = juce::jmax(1, (int)(fps * 0.5));
+        std::vector<float> e((size_t)n);
+        for (int t = 0; t < n; ++t)
+        {
+            const int lo = juce::jmax(0, t - radius), hi = juce::jmin(n, t + radius + 1);
+            const double mean = (sums[(size_t)hi] - sums[(size_t)lo]) / (hi - lo);
+            e[(size_t)t] = juce::jmax(0.0f, onsets.envelope[(size_t)t] - (float)mean);
+        }
+
+        std::vector<double> correlation((size_t)maxLag + 2, 0.0);
+        for (int lag = minLag - 1; lag <= maxLag + 1; ++lag)
+        {
+            double sum = 0.0;
+            for (int t = 0; t + lag < n; ++t)
+                sum += (double)e[(size_t)t] * e[(size_t)(t + lag)];
+
+            correlation[(size_t)lag] = sum / (n - lag);
+        }
+
+        int bestLag = 0;
+        double bestScore = 0.0;
+        for (int lag = minLag; lag <= maxLag; ++lag)
+        {
+            const double octaves = std::log2(60.0 * fps / lag / 120.0);
+            const double score = correlation[(size_t)lag] * std::exp(-0.5 * octaves * octaves);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                bestLag = lag;
+            }
+        }
+
+        if (bestLag == 0)
+            return;
+
+        // parabolic interpolation between lags for a fractional period
+        const double a = correlation[(size_t)bestLag - 1], b = correlation[(size_t)bestLag], c = correlation[(size_t)bestLag + 1];
+        const double denominator = a - 2.0 * b + c;
+        double period = bestLag + (denominator < 0.0 ? juce::jlimit(-0.5, 0.5, 0.5 * (a - c) / denominator) : 0.0);
+
+        bpm = 60.0 * fps / period;
+        while (bpm < 70.0) { bpm *= 2.0; period *= 0.5; }
+        while (bpm > 180.0) { bpm *= 0.5; period *= 2.0; }
+
+        auto interpolate = [&e, n](double t)
+        {
+            const int i = (int)t;
+            if (i + 1 >= n)
+                return 0.0f;
+
+            const float frac = (float)(t - i);
+            return e[(size_t)i] + frac * (e[(size_t)i + 1] - e[(size_t)i]);
+        };
+
+        double bestPhase = 0.0, bestPhaseScore = -1.0;
+        for (double phase = 0.0; phase < period; phase += 0.25)
+        {
+            double score = 0.0;
+            for (double t = phase; t < n - 1; t += period)
+                score += interpolate(t);
+
+            if (score > bestPhaseScore)
+            {
+                bestPhaseScore = score;
+                bestPhase = phase;
+            }
+        }
+
+        firstBeatSeconds = onsets.frameCentreSeconds + bestPhase / fps;
+    }
+
+    //==========================================================================
+    // Energy per pitch class over the whole track, from long frames so that
+    // neighbouring semitones land in different bins.
+    class ChromaAccumulator
+    {
+    public:
+        explicit ChromaAccumulator(double sampleRate)
+            : stft(sampleRate > 50000.0 ? 14 : 13, sampleRate > 50000.0 ? 8192 : 4096)
+        {
+            const double binHz = sampleRate / stft.getFrameSize();
+            pitchClassOfBin.resize((size_t)stft.getNumBins(), -1);
+
+            // from where the bins are narrower than a semitone to where
+            // harmonics stop saying much about the key
+            for (int k = 1; k < stft.getNumBins(); ++k)
+            {
+                const double hz = k * binHz;
+                if (hz < 100.0 || hz > 2000.0)
+                    continue;
+
+                const int midi = juce::roundToInt(69.0 + 12.0 * std::log2(hz / 440.0));
+                pitchClassOfBin[(size_t)k] = midi % 12;
+            }
+        }
+
+        void push(const float* samples, int numSamples)
+        {
+            stft.push(samples, numSamples, [this](const float* magnitudes)
+            {
+                for (size_t k = 0; k < pitchClassOfBin.size(); ++k)
+                    if (pitchClassOfBin[k] >= 0)
+                        chroma[(size_t)pitchClassOfBin[k]] += (double)magnitudes[k] * magnitudes[k];
+            });
+        }
+
+        // Krumhansl-Schmuckler: the major or minor key profile that correlates
+        // best with the chroma, over all twelve tonics
+        juce::String estimateKey() const
+        {
+            static const double major[] = { 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 };
+            static const double minor[] = { 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 };
+            static const char* const names[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+            if (std::accumulate(chroma.begin(), chroma.end(), 0.0) <= 0.0)
+                return {};
+
+            auto correlate = [this](const double* profile, int tonic)
+            {
+                double meanX = 0.0, meanY = 0.0;
+                for (int i = 0; i < 12; ++i)
+                {
+                    meanX += chroma[(size_t)((i + tonic) % 12)];
+                    meanY += profile[i];
+                }
+                meanX /= 12.0;
+                meanY /= 12.0;
+
+                double xy = 0.0, xx = 0.0, yy = 0.0;
+                for (int i = 0; i < 12; ++i)
+                {
+                    const double x = chroma[(size_t)((i + tonic) % 12)] - meanX, y = profile[i] - meanY;
+                    xy += x * y;
+                    xx += x * x;
+                    yy += y * y;
+                }
+
+                return xx > 0.0 ? xy / std::sqrt(xx * yy) : 0.0;
+            };
+
+            juce::String best;
+            double bestScore = -2.0;
+            for (int tonic = 0; tonic < 12; ++tonic)
+            {
+                for (bool isMinor : { false, true })
+                {
+                    const double score = correlate(isMinor ? minor : major, tonic);
+                    if (score > bestScore)
+                    {
+                        bestScore = score;
+                        best = juce::String(names[tonic]) + (isMinor ? "m" : "");
+                    }
+                }
+            }
+
+            return best;
+        }
+
+    private:
+        Stft stft;
+        std::vector<int> pitchClassOfBin;
+        std::array<double, 12> chroma{};
+    };
+
+    //==========================================================================
+    // ITU-R BS.1770 / EBU R128 integrated loudness: K-weighted mean square in
+    // 400ms blocks every 100ms, gated at -70 LUFS and then at 10 LU below the
+    // loudness of what passed the first gate.
+    class LoudnessMeter
+    {
+    public:
+        explicit LoudnessMeter(double sampleRate)
+            : kWeighting(sampleRate),
+              samplesPerStep(juce::jmax(1, juce::roundToInt(sampleRate * 0.1)))
+        {
+        }
+
+        void process(const juce::AudioBuffer<float>& block, int numChannels, int numSamples)
+        {
+            for (int done = 0; done < numSamples;)
+            {
+                const int count = juce::jmin(numSamples - done, samplesPerStep - stepFill);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    const float* data = block.getReadPointer(channel, done);
+
+                    for (int i = 0; i < count; ++i)
+                    {
+                        const double y = kWeighting.process(channel, data[i]);
+                        stepEnergy += y * y;
+                    }
+                }
+
+                done += count;
+                stepFill += count;
+
+                if (stepFill == samplesPerStep)
+                {
+                    steps.push_back(stepEnergy / samplesPerStep);
+                    stepEnergy = 0.0;
+                    stepFill = 0;
+                }
+            }
+        }
+
+        double getIntegratedLoudness() const
+        {
+            std::vector<double> blocks;
+            for (size_t i = 0; i + 4 <= steps.size(); ++i)
+                blocks.push_back(0.25 * (steps[i] + steps[i + 1] + steps[i + 2] + steps[i + 3]));
+
+            auto gatedMean = [&](double gateLufs)
+            {
+                double sum = 0.0;
+                int count = 0;
+                for (auto z : blocks)
+                {
+                    if (KWeighting::toLufs(z) > gateLufs)
+                    {
+                        sum += z;
+                        ++count;
+                    }
+                }
+                return count > 0 ? sum / count : 0.0;
+            };
+
+            const double absoluteGated = gatedMean(-70.0);
+            if (absoluteGated <= 0.0)
+                return -70.0;
+
+            const double relativeGated = gatedMean(KWeighting::toLufs(absoluteGated) - 10.0);
+            return relativeGated > 0.0 ? KWeighting::toLufs(relativeGated) : -70.0;
+        }
+
+    private:
+        KWeighting kWeighting;
+        const int samplesPerStep;
+        int stepFill = 0;
+        double stepEnergy = 0.0;
+        std::vector<double> steps; // mean square of each 100ms step, summed over channels
+    };
+
+    //==========================================================================
+    // Peak of the signal between samples too, by 4x polyphase windowed-sinc
+    // oversampling as BS.1770 suggests (2x at high sample rates).
+    class TruePeakMeter
+    {
+    public:
+        TruePeakMeter(double sampleRate, int maxBlockSize)
+            : numPhases(sampleRate > 50000.0 ? 2 : 4)
+        {
+            const int length = numPhases * tapsPerPhase;
+            const double centre = 0.5 * (length - 1);
+            coefficients.resize((size_t)length);
+
+            for (int n = 0; n < length; ++n)
+            {
+                const double t = (n - centre) / numPhases;
+                const double sinc = t == 0.0 ? 1.0 : std::sin(juce::MathConstants<double>::pi * t) / (juce::MathConstants<double>::pi * t);
+                const double w = 0.42 - 0.5 * std::cos(juce::MathConstants<double>::twoPi * (n + 0.5) / length)
+                                 + 0.08 * std::cos(2.0 * juce::MathConstants<double>::twoPi * (n + 0.5) / length);
+                coefficients[(size_t)n] = (float)(sinc * w);
+            }
+
+            // unity gain at DC for every phase
+            for (int p = 0; p < numPhases; ++p)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < tapsPerPhase; ++k)
+                    sum += coefficients[(size_t)(k * numPhases + p)];
+
+                for (int k = 0; k < tapsPerPhase; ++k)
+                    coefficients[(size_t)(k * numPhases + p)] /= sum;
+            }
+
+            for (auto& h : history)
+                h.assign((size_t)(tapsPerPhase - 1 + maxBlockSize), 0.0f);
+
+            output.resize((size_t)maxBlockSize);
+        }
+
+        void process(const juce::AudioBuffer<float>& block, int numChannels, int numSamples)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto& extended = history[(size_t)channel];
+                juce::FloatVectorOperations::copy(extended.data() + tapsPerPhase - 1, block.getReadPointer(channel), numSamples);
+
+                for (int p = 0; p < numPhases; ++p)
+                {
+                    // each phase is a short FIR over the input, done as one
+                    // vector multiply-add per tap
+                    juce::FloatVectorOperations::clear(output.data(), numSamples);
+                    for (int k = 0; k < tapsPerPhase; ++k)
+                        juce::FloatVectorOperations::addWithMultiply(output.data(), extended.data() + tapsPerPhase - 1 - k,
+                                                                     coefficients[(size_t)(k * numPhases + p)], numSamples);
+
+                    const auto range = juce::FloatVectorOperations::findMinAndMax(output.data(), numSamples);
+                    peak = juce::jmax(peak, -range.getStart(), range.getEnd());
+                }
+
+                // keep the last few samples for the next block's filters
+                std::memmove(extended.data(), extended.data() + numSamples, (size_t)(tapsPerPhase - 1) * sizeof(float));
+            }
+        }
+
+        double getTruePeakDb() const { return juce::Decibels::gainToDecibels((double)peak, -100.0); }
+
+    private:
+        static constexpr int tapsPerPhase = 12;
+        const int numPhases;
+        std::vector<float> coefficients;
+        std::array<std::vector<float>, 2> history;
+        std::vector<float> output;
+        float peak = 0.0f;
+    };
+
+    //==========================================================================
+    // The first and last 10ms windows whose peak reaches -60 dBFS.
+    class SilenceDetector
+    {
+    public:
+        explicit SilenceDetector(double sampleRate)
+            : samplesPerWindow(juce::jmax(1, juce::roundToInt(sampleRate * 0.01)))
+        {
+        }
+
+        void process(const juce::AudioBuffer<float>& block, int numChannels, int numSamples)
+        {
+            for (int done = 0; done < numSamples;)
+            {
+                const int count = juce::jmin(numSamples - done, samplesPerWindow - windowFill);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    windowPeak = juce::jmax(windowPeak, block.getMagnitude(channel, done, count));
+
+                done += count;
+                windowFill += count;
+
+                if (windowFill == samplesPerWindow)
+                    endWindow();
+            }
+        }
+
+        void finish(juce::int64 lengthInSamples, double sampleRate, double& leading, double& trailing)
+        {
+            if (windowFill > 0)
+                endWindow();
+
+            if (firstLoudWindow < 0)
+            {
+                leading = (double)lengthInSamples / sampleRate;
+                trailing = 0.0;
+                return;
+            }
+
+            leading = (double)firstLoudWindow * samplesPerWindow / sampleRate;
+            trailing = juce::jmax(0.0, (double)(lengthInSamples - (lastLoudWindow + 1) * samplesPerWindow) / sampleRate);
+        }
+
+    private:
+        void endWindow()
+        {
+            if (windowPeak >= threshold)
+            {
+                if (firstLoudWindow < 0)
+                    firstLoudWindow = windowIndex;
+
+                lastLoudWindow = windowIndex;
+            }
+
+            ++windowIndex;
+            windowFill = 0;
+            windowPeak = 0.0f;
+        }
+
+        static constexpr float threshold = 0.001f; // -60 dBFS
+        const int samplesPerWindow;
+        int windowFill = 0;
+        float windowPeak = 0.0f;
+        juce::int64 windowIndex = 0;
+        juce::int64 firstLoudWindow = -1;
+        juce::int64 lastLoudWindow = -1;
+    };
+}
+
+//==============================================================================
+bool TrackAnalyser::analyse(juce::AudioFormatReader& reader, Result& result)
+{
+    const double sampleRate = reader.sampleRate;
+    const auto length = reader.lengthInSamples;
+
+    if (sampleRate <= 0.0 || length <= 0)
+        return false;
+
+    const int numChannels = juce::jlimit(1, 2, (int)reader.numChannels);
+    constexpr int blockSize = 1 << 15;
+
+    OnsetDetector onsets(sampleRate);
+    ChromaAccumulator chroma(sampleRate);
+    LoudnessMeter loudness(sampleRate);
+    TruePeakMeter truePeak(sampleRate, blockSize);
+    SilenceDetector silence(sampleRate);
+
+    juce::AudioBuffer<float> block(2, blockSize);
+    std::vector<float> mono((size_t)blockSize);
+
+    for (juce::int64 position = 0; position < length; position += blockSize)
+    {
+        if (auto* job = juce::ThreadPoolJob::getCurrentThreadPoolJob())
+            if (job->shouldExit())
+                return false;
+
+        const int numSamples = (int)juce::jmin((juce::int64)blockSize, length - position);
+        reader.read(&block, 0, numSamples, position, true, numChannels > 1);
+
+        loudness.process(block, numChannels, numSamples);
+        truePeak.process(block, numChannels, numSamples);
+        silence.process(block, numChannels, numSamples);
+
+        juce::FloatVectorOperations::copy(mono.data(), block.getReadPointer(0), numSamples);
+        if (numChannels > 1)
+        {
+            juce::FloatVectorOperations::add(mono.data(), block.getReadPointer(1), numSamples);
+            juce::FloatVectorOperations::multiply(mono.data(), 0.5f, numSamples);
+        }
+
+        onsets.push(mono.data(), numSamples);
+        chroma.push(mono.data(), numSamples);
+    }
+
+    result = {};
+    estimateTempo(onsets, result.bpm, result.firstBeatSeconds);
+    result.key = chroma.estimateKey();
+    result.loudness = loudness.getIntegratedLoudness();
+    result.truePeak = truePeak.getTruePeakDb();
+    silence.finish(length, sampleRate, result.leadingSilence, result.trailingSilence);
+    return true;
+}
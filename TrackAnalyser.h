@@ -0,0 +1,25 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Offline analysis of a whole track in one pass over the decoded audio:
+// tempo and beat grid from the spectral-flux onset envelope, musical key
+// from a chromagram, EBU R128 integrated loudness and true peak, and the
+// silence at either end. Takes a few seconds per track, so run it on a
+// background thread; it gives up early if the ThreadPoolJob it runs in is
+// asked to exit.
+class TrackAnalyser
+{
+public:
+    struct Result
+    {
+        double bpm = 0.0;               // 0 if no steady beat was found
+        double firstBeatSeconds = 0.0;  // grid anchor; beats every 60 / bpm from here
+        juce::String key;               // e.g. "Am" or "F#", empty if atonal
+        double loudness = -70.0;        // integrated, LUFS
+        double truePeak = -100.0;       // dBTP
+        double leadingSilence = 0.0;    // seconds below -60 dBFS at the start
+        double trailingSilence = 0.0;   // ... and at the end
+    };
+
+    static bool analyse(juce::AudioFormatReader& reader, Result& result);
+};
@@ -0,0 +1,294 @@
+#include "VarispeedSource.h"
+#include "AudioProfiler.h"
+
+namespace
+{
+    constexpr int halfTaps = 16;
+    constexpr int numTaps = halfTaps * 2;
+    constexpr int numPhases = 256;
+
+    // the sinc taps are summed in this many independent lanes, which the
+    // compiler can keep in one vector register without reassociating floats
+    constexpr int numLanes = 8;
+    static_assert(numTaps % numLanes == 0, "the taps must split evenly into lanes");
+
+    float dotProduct(const float* kernel, const float* samples)
+    {
+        float lanes[numLanes] = {};
+
+        for (int tap = 0; tap < numTaps; tap += numLanes)
+            for (int lane = 0; lane < numLanes; ++lane)
+                lanes[lane] += kernel[tap + lane] * samples[tap + lane];
+
+        float sum = 0.0f;
+        for (auto lane : lanes)
+            sum += lane;
+
+        return sum;
+    }
+
+    // Blackman-windowed sinc kernels, precomputed once for the whole app. Each
+    // table has numPhases + 1 rows of numTaps coefficients, so a fractional
+    // position can blend the two rows either side of it. Speeding up needs a
+    // lower cutoff to avoid aliasing, so there's one table per ratio band.
+    struct SincTables
+    {
+        static constexpr int numTables = 8;
+        static constexpr double bandRatios[numTables] = { 1.0, 1.1, 1.25, 1.5, 2.0, 3.0, 4.0, 8.0 };
+        static constexpr int tableSize = (numPhases + 1) * numTaps;
+
+        SincTables()
+            : coefficients((size_t)(numTables * tableSize))
+        {
+            for (int table = 0; table < numTables; ++table)
+            {
+                // a little below the Nyquist frequency of the slower side
+                const double cutoff = 0.97 / bandRatios[table];
+
+                for (int phase = 0; phase <= numPhases; ++phase)
+                {
+                    auto* row = coefficients.data() + table * tableSize + phase * numTaps;
+                    const double fraction = (double)phase / numPhases;
+                    double sum = 0.0;
+
+                    for (int tap = 0; tap < numTaps; ++tap)
+                    {
+                        const double x = tap - (halfTaps - 1) - fraction;
+                        const double sinc = x == 0.0 ? cutoff
+                                                     : std::sin(juce::MathConstants<double>::pi * cutoff * x)
+                                                           / (juce::MathConstants<double>::pi * x);
+                        const double window = std::abs(x) >= halfTaps
+                            ? 0.0
+                            : 0.42 + 0.5 * std::cos(juce::MathConstants<double>::pi * x / halfTaps)
+                                   + 0.08 * std::cos(juce::MathConstants<double>::twoPi * x / halfTaps);
+
+                        row[tap] = (float)(sinc * window);
+                        sum += sinc * window;
+                    }
+
+                    // unity gain at DC for every phase, or the output ripples
+                    for (int tap = 0; tap < numTaps; ++tap)
+                        row[tap] = (float)(row[tap] / sum);
+                }
+            }
+        }
+
+        const float* getTableFor(double ratio) const
+        {
+            int table = 0;
+            while (table < numTables - 1 && bandRatios[table] < ratio)
+                ++table;
+
+            return coefficients.data() + table * tableSize;
+        }
+
+        std::vector<float> coefficients;
+    };
+
+    const SincTables& getSincTables()
+    {
+        static const SincTables tables;
+        return tables;
+    }
+}
+
+VarispeedSource::VarispeedSource(juce::AudioSource* inputSource, int maxNumChannels)
+    : input(inputSource),
+      maxChannels(juce::jmax(1, maxNumChannels))
+{
+    jassert(input != nullptr);
+
+    // build the kernels now rather than on the first audio callback
+    getSincTables();
+}
+
+VarispeedSource::~VarispeedSource() = default;
+
+void VarispeedSource::reset()
+{
+    // the history is written through raw pointers, so the buffer's own
+    // "already clear" flag can't be trusted
+    history.setNotClear();
+    history.clear();
+    numHeld = halfTaps - 1;
+    readPosition = halfTaps - 1;
+}
+
+void VarispeedSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    maxChunk = juce::jmax(256, samplesPerBlockExpected);
+
+    // room for the kernel's history plus one chunk's worth of input at the
+    // highest ratio
+    const int capacity = numTaps + halfTaps + 2 + (int)std::ceil(maxChunk * maxRatio);
+    history.setSize(maxChannels, capacity);
+    reset();
+
+    input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void VarispeedSource::releaseResources()
+{
+    input->releaseResources();
+    history.setSize(maxChannels, 0);
+    maxChunk = 0;
+}
+
+void VarispeedSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    AudioProfiler::ScopedStage stage(AudioProfiler::Stage::resample);
+
+    if (maxChunk == 0)
+    {
+        bufferToFill.clearActiveBufferRegion();
+        return;
+    }
+
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        const int chunk = juce::jmin(bufferToFill.numSamples - done, maxChunk);
+        renderChunk(juce::AudioSourceChannelInfo(bufferToFill.buffer, bufferToFill.startSample + done, chunk));
+        done += chunk;
+    }
+}
+
+void VarispeedSource::renderChunk(const juce::AudioSourceChannelInfo& info)
+{
+    const int numChannels = juce::jmin(info.buffer->getNumChannels(), maxChannels);
+    const int numSamples = info.numSamples;
+
+    if (ratio == 1.0)
+    {
+        // a straight copy can't start between samples
+        readPosition = std::floor(readPosition);
+        renderBypass(info, numChannels);
+        return;
+    }
+
+    // pull just enough input for the last output sample's kernel
+    const double lastPosition = readPosition + (numSamples - 1) * ratio;
+    const int needed = (int)lastPosition + halfTaps + 1 - numHeld;
+
+    if (needed > 0)
+    {
+        juce::AudioBuffer<float> view(history.getArrayOfWritePointers(), numChannels, history.getNumSamples());
+        input->getNextAudioBlock(juce::AudioSourceChannelInfo(&view, numHeld, needed));
+        numHeld += needed;
+    }
+
+    if (quality == Quality::sinc)
+    {
+        // Sample-major, so the kernel for each output position is blended
+        // from its two table rows once and shared by every channel.
+        const float* sincTable = getSincTables().getTableFor(ratio);
+        double position = readPosition;
+
+        for (int i = 0; i < numSamples; ++i, position += ratio)
+        {
+            const int index = (int)position;
+            const double phase = (position - index) * numPhases;
+            const int row = (int)phase;
+            const float blend = (float)(phase - row);
+
+            const float* a = sincTable + row * numTaps;
+            const float* b = a + numTaps;
+
+            alignas(32) float kernel[numTaps];
+            for (int tap = 0; tap < numTaps; ++tap)
+                kernel[tap] = a[tap] + blend * (b[tap] - a[tap]);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                info.buffer->getWritePointer(channel, info.startSample)[i]
+                    = dotProduct(kernel, history.getReadPointer(channel, index - (halfTaps - 1)));
+        }
+    }
+
+    // the cheaper tiers read at a fractional stride, so they're gathers
+    // rather than anything that vectorises, and stay per channel
+    for (int channel = 0; channel < numChannels && quality != Quality::sinc; ++channel)
+    {
+        const float* in = history.getReadPointer(channel);
+        float* out = info.buffer->getWritePointer(channel, info.startSample);
+        double position = readPosition;
+
+        if (quality == Quality::linear)
+        {
+            for (int i = 0; i < numSamples; ++i, position += ratio)
+            {
+                const int index = (int)position;
+                const float x = (float)(position - index);
+                out[i] = in[index] + x * (in[index + 1] - in[index]);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < numSamples; ++i, position += ratio)
+            {
+                const int index = (int)position;
+                const float x = (float)(position - index);
+                const float* s = in + index - 1;
+
+                out[i] = s[0] * (-x * (x - 1.0f) * (x - 2.0f) * (1.0f / 6.0f))
+                       + s[1] * ((x + 1.0f) * (x - 1.0f) * (x - 2.0f) * 0.5f)
+                       + s[2] * (-(x + 1.0f) * x * (x - 2.0f) * 0.5f)
+                       + s[3] * ((x + 1.0f) * x * (x - 1.0f) * (1.0f / 6.0f));
+            }
+        }
+    }
+
+    for (int channel = numChannels; channel < info.buffer->getNumChannels(); ++channel)
+        info.buffer->clear(channel, info.startSample, numSamples);
+
+    // drop the input we've moved past, keeping the kernel's history
+    readPosition += numSamples * ratio;
+    const int consumed = (int)readPosition - (halfTaps - 1);
+    const int remaining = numHeld - consumed;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        auto* data = history.getWritePointer(channel);
+        std::memmove(data, data + consumed, (size_t)remaining * sizeof(float));
+    }
+
+    numHeld = remaining;
+    readPosition -= consumed;
+}
+
+void VarispeedSource::renderBypass(const juce::AudioSourceChannelInfo& info, int numChannels)
+{
+    // At unity the output is the input, so fresh input is rendered straight
+    // into the output and only the kernel's tail is copied back into the
+    // history, rather than the whole block passing through it.
+    const int numSamples = info.numSamples;
+    const int readIndex = (int)readPosition;
+    const int held = juce::jlimit(0, numSamples, numHeld - readIndex);   // already in the history
+    const int direct = numSamples - held;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+        juce::FloatVectorOperations::copy(info.buffer->getWritePointer(channel, info.startSample),
+                                          history.getReadPointer(channel, readIndex), held);
+
+    if (direct > 0)
+        input->getNextAudioBlock(juce::AudioSourceChannelInfo(info.buffer, info.startSample + held, direct));
+
+    // keep what the kernels need behind the new read position, plus anything
+    // held beyond it, exactly as the resampling path leaves the history
+    const int newRead = readIndex + numSamples;
+    const int streamEnd = juce::jmax(numHeld, newRead);
+    const int keepFrom = newRead - (halfTaps - 1);
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float* data = history.getWritePointer(channel);
+        const float* out = info.buffer->getReadPointer(channel, info.startSample);
+
+        for (int p = keepFrom; p < streamEnd; ++p)
+            data[p - keepFrom] = p < numHeld ? data[p] : out[p - readIndex];
+    }
+
+    for (int channel = numChannels; channel < info.buffer->getNumChannels(); ++channel)
+        info.buffer->clear(channel, info.startSample, numSamples);
+
+    numHeld = streamEnd - keepFrom;
+    readPosition = halfTaps - 1;
+}
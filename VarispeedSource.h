@@ -0,0 +1,59 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Variable-ratio resampler used for a deck's speed control and for playing
+// files whose rate differs from the device's. Unlike ResamplingAudioSource it
+// handles however many channels the output buffer has, and offers three
+// quality tiers. At a ratio of exactly 1.0 samples are copied straight
+// through, whatever the tier.
+class VarispeedSource : public juce::AudioSource
+{
+public:
+    enum class Quality
+    {
+        linear,     // cheapest, audible aliasing and high-frequency droop
+        lagrange,   // 4-point cubic, no anti-aliasing when speeding up
+        sinc        // 32-tap windowed sinc, band-limited to the lower of the two rates
+    };
+
+    explicit VarispeedSource(juce::AudioSource* input, int maxNumChannels = 8);
+    ~VarispeedSource() override;
+
+    // Input samples consumed per output sample. Audio thread only.
+    void setRatio(double newRatio) { ratio = juce::jlimit(minRatio, maxRatio, newRatio); }
+    double getRatio() const { return ratio; }
+
+    // Audio thread only; switching tiers is click-free because every tier
+    // reads from the same history.
+    void setQuality(Quality newQuality) { quality = newQuality; }
+    Quality getQuality() const { return quality; }
+
+    // Drops buffered input, e.g. after the input has been repositioned.
+    void reset();
+
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    static constexpr double minRatio = 1.0 / 16.0;
+    static constexpr double maxRatio = 16.0;
+
+private:
+    void renderChunk(const juce::AudioSourceChannelInfo& info);
+    void renderBypass(const juce::AudioSourceChannelInfo& info, int numChannels);
+
+    juce::AudioSource* input;
+    juce::AudioBuffer<float> history;
+    const int maxChannels;
+    int maxChunk = 0;
+
+    // history holds numHeld input samples; readPosition is where the next
+    // output sample interpolates, always within [halfTaps - 1, halfTaps)
+    int numHeld = 0;
+    double readPosition = 0.0;
+
+    double ratio = 1.0;
+    Quality quality = Quality::sinc;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VarispeedSource)
+};
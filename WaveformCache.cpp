@@ -0,0 +1,387 @@
+#include "WaveformCache.h"
+#include "AppData.h"
+
+namespace
+{
+    constexpr juce::uint32 cacheMagic = 0x31434657; // "WFC1"
+    constexpr juce::uint32 cacheVersion = 1;
+
+    struct FileHeader
+    {
+        juce::uint32 magic;
+        juce::uint32 version;
+        juce::uint32 numChannels;
+        juce::uint32 numLevels;
+        double sampleRate;
+        juce::int64 lengthInSamples;
+        juce::int64 sourceSize;
+        juce::int64 sourceModificationTime;
+    };
+
+    struct LevelEntry
+    {
+        juce::int64 offset;
+        juce::int64 numPoints;
+        juce::int32 samplesPerPoint;
+        juce::int32 reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == 48, "cache header layout must not change");
+    static_assert(sizeof(LevelEntry) == 24, "cache level table layout must not change");
+    static_assert(sizeof(WaveformCache::Point) == 3, "cache points are stored packed");
+
+    // full-precision summary used while building, quantised when written
+    struct Summary
+    {
+        float minValue = 0.0f;
+        float maxValue = 0.0f;
+        float meanSquare = 0.0f;
+    };
+
+    WaveformCache::Point quantise(const Summary& s)
+    {
+        auto toInt8 = [](float v) { return (juce::int8)juce::roundToInt(juce::jlimit(-1.0f, 1.0f, v) * 127.0f); };
+
+        WaveformCache::Point p;
+        p.minValue = toInt8(s.minValue);
+        p.maxValue = toInt8(s.maxValue);
+        p.rms = (juce::uint8)juce::roundToInt(juce::jlimit(0.0f, 1.0f, std::sqrt(s.meanSquare)) * 255.0f);
+        return p;
+    }
+}
+
+//==============================================================================
+std::unique_ptr<WaveformCache::Overview> WaveformCache::Overview::open(const juce::File& cacheFile,
+                                                                       juce::int64 sourceSize,
+                                                                       juce::int64 sourceModificationTime)
+{
+    if (!cacheFile.existsAsFile())
+        return nullptr;
+
+    auto map = std::make_unique<juce::MemoryMappedFile>(cacheFile, juce::MemoryMappedFile::readOnly);
+    const auto* base = static_cast<const char*>(map->getData());
+    const auto size = (juce::int64)map->getSize();
+
+    if (base == nullptr || size < (juce::int64)sizeof(FileHeader))
+        return nullptr;
+
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+
+    if (header.magic != cacheMagic || header.version != cacheVersion
+        || header.sourceSize != sourceSize || header.sourceModificationTime != sourceModificationTime
+        || header.numChannels == 0 || header.numLevels == 0
+        || size < (juce::int64)(sizeof(FileHeader) + header.numLevels * sizeof(LevelEntry)))
+        return nullptr;
+
+    std::unique_ptr<Overview> overview(new Overview());
+    overview->numChannels = (int)header.numChannels;
+    overview->sampleRate = header.sampleRate;
+    overview->lengthInSamples = header.lengthInSamples;
+
+    for (juce::uint32 i = 0; i < header.numLevels; ++i)
+    {
+        LevelEntry entry;
+        std::memcpy(&entry, base + sizeof(FileHeader) + i * sizeof(LevelEntry), sizeof(entry));
+
+        const auto bytes = entry.numPoints * (juce::int64)header.numChannels * (juce::int64)sizeof(Point);
+        if (entry.offset < 0 || entry.numPoints <= 0 || entry.samplesPerPoint <= 0 || entry.offset + bytes > size)
+            return nullptr;
+
+        Level level;
+        level.samplesPerPoint = entry.samplesPerPoint;
+        level.numPoints = entry.numPoints;
+        level.points = reinterpret_cast<const Point*>(base + entry.offset);
+        overview->levels.push_back(level);
+    }
+
+    overview->map = std::move(map);
+    return overview;
+}
+
+int WaveformCache::Overview::getLevelForResolution(double samplesPerPixel) const
+{
+    int best = 0;
+
+    for (int i = 1; i < getNumLevels(); ++i)
+        if ((double)levels[(size_t)i].samplesPerPoint <= samplesPerPixel)
+            best = i;
+
+    return best;
+}
+
+void WaveformCache::Overview::getRange(int levelIndex, int channel, juce::int64 startSample, juce::int64 endSample,
+                                       float& minValue, float& maxValue, float& rms) const
+{
+    const auto& level = levels[(size_t)juce::jlimit(0, getNumLevels() - 1, levelIndex)];
+    channel = juce::jlimit(0, numChannels - 1, channel);
+
+    const auto first = juce::jlimit((juce::int64)0, level.numPoints - 1, startSample / level.samplesPerPoint);
+    const auto last = juce::jlimit(first + 1, level.numPoints, (endSample + level.samplesPerPoint - 1) / level.samplesPerPoint);
+
+    int lo = 127, hi = -127;
+    float sumSquares = 0.0f;
+
+    for (auto i = first; i < last; ++i)
+    {
+        const auto& p = level.points[i * numChannels + channel];
+        lo = juce::jmin(lo, (int)p.minValue);
+        hi = juce::jmax(hi, (int)p.maxValue);
+        sumSquares += (float)p.rms * (float)p.rms;
+    }
+
+    minValue = (float)lo / 127.0f;
+    maxValue = (float)hi / 127.0f;
+    rms = std::sqrt(sumSquares / (float)(last - first)) / 255.0f;
+}
+
+void WaveformCache::Overview::drawChannels(juce::Graphics& g, juce::Rectangle<int> area,
+                                           double startTime, double endTime,
+                                           juce::Colour peakColour, juce::Colour rmsColour) const
+{
+    if (area.isEmpty() || endTime <= startTime || numChannels == 0)
+        return;
+
+    const double samplesPerPixel = (endTime - startTime) * sampleRate / area.getWidth();
+    const int level = getLevelForResolution(samplesPerPixel);
+    const int laneHeight = area.getHeight() / numChannels;
+
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        const auto lane = area.withHeight(laneHeight).withY(area.getY() + channel * laneHeight);
+        const float centre = (float)lane.getCentreY();
+        const float halfHeight = lane.getHeight() * 0.5f;
+
+        for (int x = 0; x < area.getWidth(); ++x)
+        {
+            const auto s0 = (juce::int64)((startTime * sampleRate) + x * samplesPerPixel);
+            const auto s1 = (juce::int64)((startTime * sampleRate) + (x + 1) * samplesPerPixel);
+
+            if (s0 >= lengthInSamples)
+                break;
+
+            float lo, hi, rms;
+            getRange(level, channel, s0, s1, lo, hi, rms);
+
+            const int px = area.getX() + x;
+            g.setColour(peakColour);
+            g.drawVerticalLine(px, centre - hi * halfHeight, centre - lo * halfHeight + 1.0f);
+            g.setColour(rmsColour);
+            g.drawVerticalLine(px, centre - rms * halfHeight, centre + rms * halfHeight + 1.0f);
+        }
+    }
+}
+
+//==============================================================================
+WaveformCache::WaveformCache()
+    : directory(getDefaultDirectory())
+{
+    directory.createDirectory();
+}
+
+WaveformCache::~WaveformCache()
+{
+    buildPool.removeAllJobs(true, 4000);
+}
+
+juce::File WaveformCache::getDefaultDirectory()
+{
+    return getAppDataDirectory().getChildFile("WaveformCache");
+}
+
+juce::File WaveformCache::getCacheFileFor(const juce::File& audioFile) const
+{
+    const auto key = audioFile.getFullPathName()
+        + "|" + juce::String(audioFile.getSize())
+        + "|" + juce::String(audioFile.getLastModificationTime().toMilliseconds());
+
+    return directory.getChildFile(juce::String::toHexString(key.hashCode64()) + ".wfc");
+}
+
+void WaveformCache::getOverview(const juce::File& audioFile, juce::AudioFormatManager& formatManager, Callback onReady)
+{
+    const auto cacheFile = getCacheFileFor(audioFile);
+    const auto key = cacheFile.getFileName();
+    const auto sourceSize = audioFile.getSize();
+    const auto sourceTime = audioFile.getLastModificationTime().toMilliseconds();
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        auto open = openOverviews.find(key);
+        if (open != openOverviews.end())
+        {
+            if (auto overview = open->second.lock())
+            {
+                juce::MessageManager::callAsync([onReady, overview] { onReady(overview); });
+                return;
+            }
+        }
+
+        // somebody already asked for this one; join the queue
+        auto& callbacks = pending[key];
+        callbacks.push_back(std::move(onReady));
+        if (callbacks.size() > 1)
+            return;
+    }
+
+    auto* fm = &formatManager;
+
+    buildPool.addJob([this, audioFile, cacheFile, key, sourceSize, sourceTime, fm]
+    {
+        std::shared_ptr<const Overview> overview = Overview::open(cacheFile, sourceSize, sourceTime);
+
+        if (overview == nullptr && build(audioFile, cacheFile, *fm))
+            overview = Overview::open(cacheFile, sourceSize, sourceTime);
+
+        deliver(key, overview);
+    });
+}
+
+void WaveformCache::deliver(const juce::String& key, OverviewPtr overview)
+{
+    std::vector<Callback> callbacks;
+
+    {
+        const juce::ScopedLock sl(lock);
+        callbacks = std::move(pending[key]);
+        pending.erase(key);
+
+        if (overview != nullptr)
+            openOverviews[key] = overview;
+    }
+
+    juce::MessageManager::callAsync([callbacks, overview]
+    {
+        for (auto& callback : callbacks)
+            if (callback != nullptr)
+                callback(overview);
+    });
+}
+
+bool WaveformCache::build(const juce::File& audioFile, const juce::File& cacheFile, juce::AudioFormatManager& formatManager)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
+    if (reader == nullptr || reader->lengthInSamples <= 0)
+        return false;
+
+    const int numChannels = juce::jlimit(1, 2, (int)reader->numChannels);
+    const auto length = reader->lengthInSamples;
+    const auto numBasePoints = (length + baseSamplesPerPoint - 1) / baseSamplesPerPoint;
+
+    // level 0, straight from the decoder
+    std::vector<std::vector<Summary>> levels(1);
+    levels[0].resize((size_t)(numBasePoints * numChannels));
+
+    constexpr int pointsPerRead = 256;
+    juce::AudioBuffer<float> block(numChannels, baseSamplesPerPoint * pointsPerRead);
+
+    for (juce::int64 point = 0; point < numBasePoints; point += pointsPerRead)
+    {
+        if (auto* job = juce::ThreadPoolJob::getCurrentThreadPoolJob())
+            if (job->shouldExit())
+                return false;
+
+        const auto startSample = point * baseSamplesPerPoint;
+        const int numSamples = (int)juce::jmin((juce::int64)block.getNumSamples(), length - startSample);
+        reader->read(&block, 0, numSamples, startSample, true, numChannels > 1);
+
+        const int numPoints = (numSamples + baseSamplesPerPoint - 1) / baseSamplesPerPoint;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const float* data = block.getReadPointer(channel);
+
+            for (int p = 0; p < numPoints; ++p)
+            {
+                const int offset = p * baseSamplesPerPoint;
+                const int count = juce::jmin(baseSamplesPerPoint, numSamples - offset);
+                const auto range = juce::FloatVectorOperations::findMinAndMax(data + offset, count);
+
+                float sumSquares = 0.0f;
+                for (int i = 0; i < count; ++i)
+                    sumSquares += data[offset + i] * data[offset + i];
+
+                auto& s = levels[0][(size_t)((point + p) * numChannels + channel)];
+                s.minValue = range.getStart();
+                s.maxValue = range.getEnd();
+                s.meanSquare = sumSquares / (float)count;
+            }
+        }
+    }
+
+    // Every further level merges pairs of points from the one below. Past
+    // 2^30 samples per point the level table's int32 would overflow, so a
+    // very long recording keeps a few points on its top level instead.
+    while (levels.back().size() > (size_t)numChannels
+           && ((juce::int64)baseSamplesPerPoint << levels.size()) <= std::numeric_limits<juce::int32>::max())
+    {
+        const auto& below = levels.back();
+        const auto numBelow = below.size() / (size_t)numChannels;
+        std::vector<Summary> above(((numBelow + 1) / 2) * (size_t)numChannels);
+
+        for (size_t p = 0; p < numBelow; p += 2)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const auto& a = below[p * (size_t)numChannels + (size_t)channel];
+                const auto& b = p + 1 < numBelow ? below[(p + 1) * (size_t)numChannels + (size_t)channel] : a;
+
+                auto& s = above[(p / 2) * (size_t)numChannels + (size_t)channel];
+                s.minValue = juce::jmin(a.minValue, b.minValue);
+                s.maxValue = juce::jmax(a.maxValue, b.maxValue);
+                s.meanSquare = 0.5f * (a.meanSquare + b.meanSquare);
+            }
+        }
+
+        levels.push_back(std::move(above));
+    }
+
+    FileHeader header;
+    header.magic = cacheMagic;
+    header.version = cacheVersion;
+    header.numChannels = (juce::uint32)numChannels;
+    header.numLevels = (juce::uint32)levels.size();
+    header.sampleRate = reader->sampleRate;
+    header.lengthInSamples = length;
+    header.sourceSize = audioFile.getSize();
+    header.sourceModificationTime = audioFile.getLastModificationTime().toMilliseconds();
+
+    juce::TemporaryFile temp(cacheFile);
+
+    {
+        juce::FileOutputStream out(temp.getFile());
+        if (!out.openedOk())
+            return false;
+
+        out.write(&header, sizeof(header));
+
+        auto offset = (juce::int64)(sizeof(FileHeader) + levels.size() * sizeof(LevelEntry));
+
+        for (size_t i = 0; i < levels.size(); ++i)
+        {
+            LevelEntry entry;
+            entry.offset = offset;
+            entry.numPoints = (juce::int64)(levels[i].size() / (size_t)numChannels);
+            entry.samplesPerPoint = baseSamplesPerPoint << i;
+            entry.reserved = 0;
+            out.write(&entry, sizeof(entry));
+
+            offset += (juce::int64)(levels[i].size() * sizeof(Point));
+        }
+
+        std::vector<Point> packed;
+        for (const auto& level : levels)
+        {
+            packed.resize(level.size());
+            std::transform(level.begin(), level.end(), packed.begin(), quantise);
+            out.write(packed.data(), packed.size() * sizeof(Point));
+        }
+
+        out.flush();
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
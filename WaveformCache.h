@@ -0,0 +1,93 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Disk-backed waveform overviews. Each audio file gets a min/max/RMS pyramid
+// (every level halves the resolution of the one below) stored in a compact
+// binary file keyed by the audio file's path, size and modification time.
+// The cache files are memory-mapped, so a track that has been seen before
+// draws immediately and a zoomed view only touches the level it needs.
+// Shared between decks through juce::SharedResourcePointer<WaveformCache>.
+class WaveformCache
+{
+public:
+    struct Point
+    {
+        juce::int8 minValue;
+        juce::int8 maxValue;
+        juce::uint8 rms;
+    };
+
+    class Overview
+    {
+    public:
+        struct Level
+        {
+            int samplesPerPoint = 0;
+            juce::int64 numPoints = 0;
+            const Point* points = nullptr;  // numPoints * numChannels, interleaved by channel
+        };
+
+        // Maps a cache file, returning nullptr if it's missing, damaged or
+        // was built from a different version of the audio file.
+        static std::unique_ptr<Overview> open(const juce::File& cacheFile,
+                                              juce::int64 sourceSize,
+                                              juce::int64 sourceModificationTime);
+
+        int getNumChannels() const { return numChannels; }
+        double getSampleRate() const { return sampleRate; }
+        juce::int64 getLengthInSamples() const { return lengthInSamples; }
+        double getLengthInSeconds() const { return sampleRate > 0.0 ? (double)lengthInSamples / sampleRate : 0.0; }
+
+        int getNumLevels() const { return (int)levels.size(); }
+        const Level& getLevel(int index) const { return levels[(size_t)index]; }
+
+        // the coarsest level that still has at least one point per pixel
+        int getLevelForResolution(double samplesPerPixel) const;
+
+        // min/max/RMS of one channel over [startSample, endSample), read from one level
+        void getRange(int level, int channel, juce::int64 startSample, juce::int64 endSample,
+                      float& minValue, float& maxValue, float& rms) const;
+
+        void drawChannels(juce::Graphics& g, juce::Rectangle<int> area,
+                          double startTime, double endTime,
+                          juce::Colour peakColour, juce::Colour rmsColour) const;
+
+    private:
+        Overview() = default;
+
+        std::unique_ptr<juce::MemoryMappedFile> map;
+        std::vector<Level> levels;
+        int numChannels = 0;
+        double sampleRate = 0.0;
+        juce::int64 lengthInSamples = 0;
+    };
+
+    using OverviewPtr = std::shared_ptr<const Overview>;
+    using Callback = std::function<void(OverviewPtr)>;
+
+    WaveformCache();
+    ~WaveformCache();
+
+    // Calls onReady on the message thread with the overview for this file,
+    // building and storing it in the background first if it isn't cached.
+    // onReady gets nullptr if the file can't be read.
+    void getOverview(const juce::File& audioFile, juce::AudioFormatManager& formatManager, Callback onReady);
+
+    static juce::File getDefaultDirectory();
+
+    static constexpr int baseSamplesPerPoint = 256;
+
+private:
+    juce::File getCacheFileFor(const juce::File& audioFile) const;
+    static bool build(const juce::File& audioFile, const juce::File& cacheFile, juce::AudioFormatManager& formatManager);
+    void deliver(const juce::String& key, OverviewPtr overview);
+
+    juce::File directory;
+    juce::ThreadPool buildPool{ 1 };
+
+    juce::CriticalSection lock;
+    std::map<juce::String, std::vector<Callback>> pending;
+    std::map<juce::String, std::weak_ptr<const Overview>> openOverviews;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformCache)
+};
@@ -0,0 +1,223 @@
+#include "WaveformView.h"
+
+WaveformView::WaveformView(PlayerAudio& playerToFollow)
+    : player(playerToFollow)
+{
+    setInterceptsMouseClicks(false, false);
+}
+
+WaveformView::~WaveformView()
+{
+    stopTimer();
+}
+
+void WaveformView::setOverview(WaveformCache::OverviewPtr newOverview)
+{
+    overview = std::move(newOverview);
+    overviewImage = {};
+    playheadX = -1;
+    invalidateZoom();
+
+    if (overview != nullptr)
+    {
+        renderOverviewInBackground();
+        startTimerHz(30);
+    }
+    else
+    {
+        ++overviewGeneration;
+        stopTimer();
+    }
+
+    repaint();
+}
+
+void WaveformView::setZoomSeconds(double seconds)
+{
+    zoomSeconds = juce::jmax(0.5, seconds);
+    invalidateZoom();
+    repaint(getZoomArea());
+}
+
+juce::Rectangle<int> WaveformView::getZoomArea() const
+{
+    return getLocalBounds().removeFromTop(getHeight() * 11 / 20);
+}
+
+juce::Rectangle<int> WaveformView::getOverviewArea() const
+{
+    return getLocalBounds().withTrimmedTop(getZoomArea().getHeight() + 2);
+}
+
+int WaveformView::getOverviewX(double seconds) const
+{
+    const double length = overview != nullptr ? overview->getLengthInSeconds() : 0.0;
+    if (length <= 0.0)
+        return -1;
+
+    const auto area = getOverviewArea();
+    return juce::roundToInt(juce::jmap(juce::jlimit(0.0, length, seconds), 0.0, length,
+                                       (double)area.getX(), (double)area.getRight()));
+}
+
+juce::Rectangle<int> WaveformView::getPlayheadStrip(int x) const
+{
+    return getOverviewArea().withX(x - 2).withWidth(4);
+}
+
+void WaveformView::resized()
+{
+    overviewImage = {};
+    invalidateZoom();
+
+    if (overview != nullptr)
+        renderOverviewInBackground();
+}
+
+void WaveformView::renderOverviewInBackground()
+{
+    const auto generation = ++overviewGeneration;
+    const auto area = getOverviewArea();
+    if (overview == nullptr || area.isEmpty())
+        return;
+
+    juce::Component::SafePointer<WaveformView> safeThis(this);
+
+    diskThreads->getLoaderPool().addJob([safeThis, generation, source = overview, area,
+                                         peak = peakColour, rms = rmsColour]
+    {
+        // a software image, since native ones may only be drawn into from
+        // the message thread on some platforms
+        juce::Image image(juce::Image::ARGB, area.getWidth(), area.getHeight(), true, juce::SoftwareImageType());
+        {
+            juce::Graphics g(image);
+            source->drawChannels(g, image.getBounds(), 0.0, source->getLengthInSeconds(), peak, rms);
+        }
+
+        juce::MessageManager::callAsync([safeThis, generation, image]
+        {
+            if (safeThis == nullptr || generation != safeThis->overviewGeneration)
+                return;
+
+            safeThis->overviewImage = image;
+            safeThis->repaint(safeThis->getOverviewArea());
+        });
+    });
+}
+
+void WaveformView::invalidateZoom()
+{
+    zoomValid = false;
+    const auto area = getZoomArea();
+
+    if (area.isEmpty())
+        zoomImage = {};
+    else if (zoomImage.getBounds() != area.withZeroOrigin())
+        zoomImage = juce::Image(juce::Image::ARGB, area.getWidth(), area.getHeight(), true, juce::SoftwareImageType());
+}
+
+double WaveformView::getZoomSamplesPerPixel() const
+{
+    return overview != nullptr && zoomImage.isValid()
+        ? zoomSeconds * overview->getSampleRate() / zoomImage.getWidth()
+        : 0.0;
+}
+
+bool WaveformView::scrollZoomTo(double seconds)
+{
+    const double samplesPerPixel = getZoomSamplesPerPixel();
+    if (samplesPerPixel <= 0.0)
+        return false;
+
+    const int width = zoomImage.getWidth();
+    const int height = zoomImage.getHeight();
+    const auto first = (juce::int64)std::floor(seconds * overview->getSampleRate() / samplesPerPixel) - width / 2;
+
+    if (zoomValid && first == zoomFirstColumn)
+        return false;
+
+    const auto delta = first - zoomFirstColumn;
+    zoomFirstColumn = first;
+
+    if (zoomValid && delta > 0 && delta < width)
+    {
+        zoomImage.moveImageSection(0, 0, (int)delta, 0, width - (int)delta, height);
+        drawZoomColumns(width - (int)delta, (int)delta);
+    }
+    else if (zoomValid && delta < 0 && -delta < width)
+    {
+        zoomImage.moveImageSection((int)-delta, 0, 0, 0, width + (int)delta, height);
+        drawZoomColumns(0, (int)-delta);
+    }
+    else
+    {
+        drawZoomColumns(0, width);
+        zoomValid = true;
+    }
+
+    return true;
+}
+
+void WaveformView::drawZoomColumns(int firstX, int numColumns)
+{
+    const juce::Rectangle<int> columns(firstX, 0, numColumns, zoomImage.getHeight());
+    zoomImage.clear(columns);
+
+    // only the columns that fall within the track have anything to draw
+    const double samplesPerPixel = getZoomSamplesPerPixel();
+    const auto lastColumn = (juce::int64)std::ceil((double)overview->getLengthInSamples() / samplesPerPixel);
+    const auto start = juce::jmax(zoomFirstColumn + firstX, (juce::int64)0);
+    const auto end = juce::jmin(zoomFirstColumn + firstX + numColumns, lastColumn);
+    if (end <= start)
+        return;
+
+    const double sampleRate = overview->getSampleRate();
+    juce::Graphics g(zoomImage);
+    overview->drawChannels(g, columns.withX((int)(start - zoomFirstColumn)).withWidth((int)(end - start)),
+                           (double)start * samplesPerPixel / sampleRate,
+                           (double)end * samplesPerPixel / sampleRate,
+                           peakColour, rmsColour);
+}
+
+void WaveformView::timerCallback()
+{
+    const double position = player.getCurrentPosition();
+
+    // the overview only changes where the playhead was and where it is now
+    const int x = getOverviewX(position);
+    if (x != playheadX)
+    {
+        if (playheadX >= 0)
+            repaint(getPlayheadStrip(playheadX));
+        if (x >= 0)
+            repaint(getPlayheadStrip(x));
+
+        playheadX = x;
+    }
+
+    if (scrollZoomTo(position))
+        repaint(getZoomArea());
+}
+
+void WaveformView::paint(juce::Graphics& g)
+{
+    if (overview == nullptr)
+        return;
+
+    const auto zoomArea = getZoomArea();
+    if (zoomImage.isValid() && zoomValid)
+        g.drawImageAt(zoomImage, zoomArea.getX(), zoomArea.getY());
+
+    g.setColour(juce::Colours::orange);
+    g.drawVerticalLine(zoomArea.getCentreX(), (float)zoomArea.getY(), (float)zoomArea.getBottom());
+
+    const auto overviewArea = getOverviewArea();
+    if (overviewImage.isValid())
+        g.drawImageAt(overviewImage, overviewArea.getX(), overviewArea.getY());
+
+    if (playheadX >= 0)
+    {
+        g.setColour(juce::Colours::red);
+        g.fillRect(getPlayheadStrip(playheadX).withSizeKeepingCentre(2, overviewArea.getHeight()));
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <JuceHeader.h>
+#include "WaveformCache.h"
+#include "DiskThreadPool.h"
+#include "PlayerAudio.h"
+
+// A deck's waveform: the whole track as an overview with the playhead moving
+// across it, and above that a zoomed view scrolling under a fixed playhead.
+// The overview is rasterised once per size on the loader pool and after that
+// only composited, and each frame repaints just the strips the playhead left
+// and entered. The zoomed view keeps its own image; as it scrolls, the image
+// is shifted along and only the newly exposed columns are drawn.
+class WaveformView : public juce::Component,
+    private juce::Timer
+{
+public:
+    explicit WaveformView(PlayerAudio& playerToFollow);
+    ~WaveformView() override;
+
+    // nullptr clears the view
+    void setOverview(WaveformCache::OverviewPtr newOverview);
+
+    // how much of the track the zoomed view spans
+    void setZoomSeconds(double seconds);
+    double getZoomSeconds() const { return zoomSeconds; }
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+private:
+    void timerCallback() override;
+
+    juce::Rectangle<int> getZoomArea() const;
+    juce::Rectangle<int> getOverviewArea() const;
+    int getOverviewX(double seconds) const;
+    juce::Rectangle<int> getPlayheadStrip(int x) const;
+
+    void renderOverviewInBackground();
+    void invalidateZoom();
+    bool scrollZoomTo(double seconds);
+    void drawZoomColumns(int firstX, int numColumns);
+    double getZoomSamplesPerPixel() const;
+
+    PlayerAudio& player;
+    WaveformCache::OverviewPtr overview;
+    juce::SharedResourcePointer<DiskThreadPool> diskThreads;
+
+    juce::Image overviewImage;
+    juce::uint32 overviewGeneration = 0;
+    int playheadX = -1;
+
+    juce::Image zoomImage;
+    juce::int64 zoomFirstColumn = 0;  // track column, at the zoomed view's samples per pixel, shown at x = 0
+    bool zoomValid = false;
+    double zoomSeconds = 8.0;
+
+    const juce::Colour peakColour = juce::Colours::lightgrey;
+    const juce::Colour rmsColour = juce::Colours::lightgrey.darker(0.6f);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformView)
+};